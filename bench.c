@@ -0,0 +1,556 @@
+/**
+ * @name IZP Projekt 2 - Benchmarks of optimized paths against plain versions
+ * 2021
+ */
+
+// Benchmarks call internal functions, so program is included without its main
+#define main setcal_main
+#include "setcal.c"
+#undef main
+
+#pragma region CONSTANTS
+/*-------------------------------- CONSTANTS --------------------------------*/
+// Define number of items of benchmark inputs
+#define BENCH_SIZE 1000000
+
+// Define number of runs, best time of them is reported
+#define BENCH_RUNS 5
+
+// Define length of generated universe names
+#define BENCH_NAME_LENGTH 6
+
+// Define size of benchmark name buffer
+#define BENCH_NAME_SIZE 40
+#pragma endregion
+#pragma region HELPERS
+/*--------------------------------- HELPERS ---------------------------------*/
+
+/**
+ * @brief Get monotonic time
+ * @return Time in milliseconds
+ */
+double bench_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/**
+ * @brief Find minimum of two times
+ * @param a First time
+ * @param b Second time
+ * @return Smaller time
+ */
+double bench_min(double a, double b) {
+    return a < b ? a : b;
+}
+
+/**
+ * @brief Print times of optimized and plain version
+ * @param name Benchmark name
+ * @param optimized Best time of optimized version in milliseconds
+ * @param plain Best time of plain version in milliseconds
+ */
+void bench_report(const char* name, double optimized, double plain) {
+    printf("%-32s %9.2f ms %9.2f ms %6.2fx\n", name, optimized, plain,
+           plain / optimized);
+}
+
+/**
+ * @brief Get random number from 0 to max (exclusive), rand is too short
+ * @param max Maximal number
+ * @return Random number
+ */
+int bench_random(int max) {
+    return (int)((((unsigned)rand() << 16) ^ (unsigned)rand()) % max);
+}
+#pragma endregion
+#pragma region UNIVERSE
+/*-------------------------------- UNIVERSE ---------------------------------*/
+
+/**
+ * @brief Find element by comparing it with every universe name
+ * @param u Universe
+ * @param name Element name
+ * @param length Element name length
+ * @return Index of element, -1 when element isn't in universe
+ */
+int bench_universe_scan(struct universe* u, const char* name, int length) {
+    for (int i = 0; i < u->size; i++) {
+        if (universe_name_equals(u, i, name, length)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Check universe for repeated names by comparing every pair of names
+ * @param u Universe
+ * @retval true - Universe doesn't contain repeated name
+ * @retval false - Universe contains repeated name
+ */
+bool bench_universe_unique(struct universe* u) {
+    for (int i = 0; i < u->size; i++) {
+        for (int j = i + 1; j < u->size; j++) {
+            if (universe_name_equals(u, j, universe_name(u, i),
+                                     universe_name_length(u, i))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find every name of set or relation line by linear scan
+ * @param u Universe
+ * @param pos Start of line content
+ * @param end End of line
+ * @return Sum of found element indexes, -1 when name isn't in universe
+ */
+long bench_scan_line(struct universe* u, const char* pos, const char* end) {
+    long sum = 0;
+    while (pos < end) {
+        // Names are separated by spaces and brackets of relation nodes
+        const char* token = pos;
+        while (pos < end && *pos != ' ' && *pos != '(' && *pos != ')') {
+            pos++;
+        }
+        if (pos > token) {
+            const int i = bench_universe_scan(u, token, pos - token);
+            if (i == -1) {
+                return -1;
+            }
+            sum += i;
+        }
+        pos++;
+    }
+    return sum;
+}
+
+/**
+ * @brief Write universe name of given element
+ * @param name Output, there has to be space for BENCH_NAME_LENGTH chars
+ * @param i Element
+ */
+void bench_write_name(char* name, int i) {
+    // Names are numbers written in letters
+    for (int k = 0; k < BENCH_NAME_LENGTH; k++, i /= 26) {
+        name[k] = 'a' + i % 26;
+    }
+}
+
+/**
+ * @brief Compare parsing of universe, set and relation lines using hash
+ * table with parsing using linear scan and pairwise repeated name check
+ *
+ * Set line holds half of universe and relation line a quarter of universe
+ * as pairs, so number of looked up names grows with universe.
+ * @param size Universe size
+ */
+void bench_universe_parse(int size) {
+    const int name_size = BENCH_NAME_LENGTH + 1;
+    const int set_size = size / 2, pair_count = size / 4;
+    const int universe_length = size * name_size - 1;
+    const int set_length = set_size * name_size - 1;
+    const int relation_length = pair_count * (2 * name_size + 2) - 1;
+    char* universe_line = malloc(universe_length + 1);
+    char* set_line = malloc(set_length + 1);
+    char* relation_line = malloc(relation_length + 1);
+    if (universe_line == NULL || set_line == NULL || relation_line == NULL) {
+        free(universe_line);
+        free(set_line);
+        free(relation_line);
+        return;
+    }
+    for (int i = 0; i < size; i++) {
+        bench_write_name(universe_line + i * name_size, i);
+        universe_line[i * name_size + BENCH_NAME_LENGTH] = ' ';
+    }
+    // Set uses random elements, repeated ones don't matter for parsing
+    for (int i = 0; i < set_size; i++) {
+        bench_write_name(set_line + i * name_size, bench_random(size));
+        set_line[i * name_size + BENCH_NAME_LENGTH] = ' ';
+    }
+    for (int i = 0; i < pair_count; i++) {
+        char* node = relation_line + i * (2 * name_size + 2);
+        node[0] = '(';
+        bench_write_name(node + 1, bench_random(size));
+        node[name_size] = ' ';
+        bench_write_name(node + name_size + 1, bench_random(size));
+        node[2 * name_size] = ')';
+        node[2 * name_size + 1] = ' ';
+    }
+
+    // Plain version is quadratic, so big universes are parsed once
+    const int runs = size > 10000 ? 1 : BENCH_RUNS;
+    double best[2] = {1e9, 1e9};
+    long sum[2] = {0, 0};
+    for (int run = 0; run < runs; run++) {
+        struct universe* u = calloc(1, sizeof(struct universe));
+        struct set s = {0};
+        struct relation r = {0};
+        double start = bench_now();
+        bool ok = u != NULL &&
+                  parse_universe(universe_line,
+                                 universe_line + universe_length, u) &&
+                  universe_build_table(u) &&
+                  parse_set(set_line, set_line + set_length, &s, u) &&
+                  parse_relation(relation_line,
+                                 relation_line + relation_length, &r, u);
+        best[0] = bench_min(best[0], bench_now() - start);
+        sum[0] = 0;
+        for (int i = 0; ok && i < s.size; i++) {
+            sum[0] += s.nodes[i];
+        }
+        for (int i = 0; ok && i < r.size; i++) {
+            sum[0] += r.nodes[i].a + r.nodes[i].b;
+        }
+        free(s.nodes);
+        free(r.nodes);
+        free_universe(u);
+
+        u = calloc(1, sizeof(struct universe));
+        start = bench_now();
+        ok = u != NULL &&
+             parse_universe(universe_line, universe_line + universe_length,
+                            u) &&
+             bench_universe_unique(u);
+        const long set_sum =
+            ok ? bench_scan_line(u, set_line, set_line + set_length) : -1;
+        const long relation_sum =
+            set_sum != -1 ? bench_scan_line(u, relation_line,
+                                            relation_line + relation_length)
+                          : -1;
+        best[1] = bench_min(best[1], bench_now() - start);
+        sum[1] = relation_sum != -1 ? set_sum + relation_sum : -1;
+        free_universe(u);
+    }
+    // Both versions have to find same elements
+    if (sum[0] != sum[1]) {
+        fprintf(stderr, "Parsed elements differ!\n");
+    }
+    char name[BENCH_NAME_SIZE];
+    snprintf(name, sizeof(name), "parse %d / scan", size);
+    bench_report(name, best[0], best[1]);
+    free(universe_line);
+    free(set_line);
+    free(relation_line);
+}
+
+/**
+ * @brief Compare parsing using hash table with linear scan over range of
+ * universe sizes
+ */
+void bench_universe_sweep() {
+    const int sizes[] = {1000, 10000, 100000};
+    for (int i = 0; i < 3; i++) {
+        bench_universe_parse(sizes[i]);
+    }
+}
+#pragma endregion
+#pragma region SORT
+/*---------------------------------- SORT -----------------------------------*/
+
+/**
+ * @brief Compare radix sort of sparse set with qsort
+ */
+void bench_set_sort() {
+    int* input = malloc(sizeof(int) * BENCH_SIZE);
+    int* nodes = malloc(sizeof(int) * BENCH_SIZE);
+    if (input == NULL || nodes == NULL) {
+        free(input);
+        free(nodes);
+        return;
+    }
+    // Range is too sparse for bitmap sort
+    for (int i = 0; i < BENCH_SIZE; i++) {
+        input[i] = bench_random(INT_MAX);
+    }
+    struct set s = {.nodes = nodes, .size = BENCH_SIZE};
+    double best[2] = {1e9, 1e9};
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        memcpy(nodes, input, sizeof(int) * BENCH_SIZE);
+        double start = bench_now();
+        set_sort(&s);
+        best[0] = bench_min(best[0], bench_now() - start);
+
+        memcpy(nodes, input, sizeof(int) * BENCH_SIZE);
+        start = bench_now();
+        qsort(nodes, BENCH_SIZE, sizeof(int), compare_num_nodes);
+        best[1] = bench_min(best[1], bench_now() - start);
+    }
+    bench_report("set sort / qsort", best[0], best[1]);
+    free(input);
+    free(nodes);
+}
+
+/**
+ * @brief Compare radix sort of relation with qsort
+ */
+void bench_relation_sort() {
+    const size_t size = sizeof(struct relation_node) * BENCH_SIZE;
+    struct relation_node* input = malloc(size);
+    struct relation_node* nodes = malloc(size);
+    if (input == NULL || nodes == NULL) {
+        free(input);
+        free(nodes);
+        return;
+    }
+    // Universe too big for packed keys
+    for (int i = 0; i < BENCH_SIZE; i++) {
+        input[i].a = bench_random(RELATION_PACKED_LIMIT * 4);
+        input[i].b = bench_random(RELATION_PACKED_LIMIT * 4);
+    }
+    struct relation r = {
+        .nodes = nodes, .size = BENCH_SIZE, .layout = RELATION_PAIRS};
+    double best[2] = {1e9, 1e9};
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        memcpy(nodes, input, size);
+        double start = bench_now();
+        relation_sort(&r);
+        best[0] = bench_min(best[0], bench_now() - start);
+
+        memcpy(nodes, input, size);
+        start = bench_now();
+        qsort(nodes, BENCH_SIZE, sizeof(struct relation_node),
+              compare_rel_nodes);
+        best[1] = bench_min(best[1], bench_now() - start);
+    }
+    bench_report("relation sort / qsort", best[0], best[1]);
+    free(input);
+    free(nodes);
+}
+
+/**
+ * @brief Compare radix sort of packed relation keys with qsort
+ */
+void bench_keys_sort() {
+    uint32_t* input = malloc(sizeof(uint32_t) * BENCH_SIZE);
+    uint32_t* keys = malloc(sizeof(uint32_t) * BENCH_SIZE);
+    if (input == NULL || keys == NULL) {
+        free(input);
+        free(keys);
+        return;
+    }
+    for (int i = 0; i < BENCH_SIZE; i++) {
+        input[i] = (uint32_t)bench_random(INT_MAX);
+    }
+    double best[2] = {1e9, 1e9};
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        memcpy(keys, input, sizeof(uint32_t) * BENCH_SIZE);
+        double start = bench_now();
+        keys_sort(keys, BENCH_SIZE);
+        best[0] = bench_min(best[0], bench_now() - start);
+
+        memcpy(keys, input, sizeof(uint32_t) * BENCH_SIZE);
+        start = bench_now();
+        qsort(keys, BENCH_SIZE, sizeof(uint32_t), compare_keys);
+        best[1] = bench_min(best[1], bench_now() - start);
+    }
+    bench_report("packed keys sort / qsort", best[0], best[1]);
+    free(input);
+    free(keys);
+}
+#pragma endregion
+#pragma region SET OPERATIONS
+/*----------------------------- SET OPERATIONS ------------------------------*/
+
+/**
+ * @brief Combine two sorted arrays node by node
+ * @param a First array
+ * @param a_size Size of first array
+ * @param b Second array
+ * @param b_size Size of second array
+ * @param keep_found Keep nodes of a found in b, otherwise nodes not found
+ * @param result Result array
+ * @return Number of nodes in result
+ */
+int bench_merge(const int* a,
+                int a_size,
+                const int* b,
+                int b_size,
+                bool keep_found,
+                int* result) {
+    int count = 0;
+    for (int i = 0, k = 0; i < a_size; i++) {
+        while (k < b_size && b[k] < a[i]) {
+            k++;
+        }
+        if ((k < b_size && b[k] == a[i]) == keep_found) {
+            result[count++] = a[i];
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Unite two sorted arrays node by node with branches on node order
+ * @param a First array
+ * @param a_size Size of first array
+ * @param b Second array
+ * @param b_size Size of second array
+ * @param result Result array
+ * @return Number of nodes in result
+ */
+int bench_merge_union(const int* a,
+                      int a_size,
+                      const int* b,
+                      int b_size,
+                      int* result) {
+    int count = 0, i = 0, k = 0;
+    while (i < a_size && k < b_size) {
+        if (a[i] < b[k]) {
+            result[count++] = a[i++];
+        } else if (b[k] < a[i]) {
+            result[count++] = b[k++];
+        } else {
+            result[count++] = a[i++];
+            k++;
+        }
+    }
+    for (; i < a_size; i++) {
+        result[count++] = a[i];
+    }
+    for (; k < b_size; k++) {
+        result[count++] = b[k];
+    }
+    return count;
+}
+
+/**
+ * @brief Combine arrays with plain merge
+ * @param a First array
+ * @param a_size Size of first array
+ * @param b Second array
+ * @param b_size Size of second array
+ * @param op Operation
+ * @param result Result array
+ * @return Number of nodes in result
+ */
+int bench_merge_combine(const int* a,
+                        int a_size,
+                        const int* b,
+                        int b_size,
+                        enum bitset_op op,
+                        int* result) {
+    if (op == BITSET_OR) {
+        return bench_merge_union(a, a_size, b, b_size, result);
+    }
+    return bench_merge(a, a_size, b, b_size, op == BITSET_AND, result);
+}
+
+/**
+ * @brief Compare array combine with plain merge for given arrays
+ *
+ * Given share of second array nodes is inside first array, other nodes are
+ * in one array only. Small arrays are combined repeatedly, so every
+ * measurement walks similar number of nodes.
+ * @param op Operation
+ * @param a_size Size of first array
+ * @param b_size Size of second array, at most size of first array
+ * @param overlap Percentage of nodes of second array inside first array
+ */
+void bench_array_combine(enum bitset_op op,
+                         int a_size,
+                         int b_size,
+                         int overlap) {
+    int* a = malloc(sizeof(int) * a_size);
+    int* b = malloc(sizeof(int) * b_size);
+    int* result = malloc(sizeof(int) * (a_size + b_size));
+    if (a == NULL || b == NULL || result == NULL) {
+        free(a);
+        free(b);
+        free(result);
+        return;
+    }
+    // Every node goes to first array, second array or both, picked at random
+    // in proportion to what is left, so arrays interleave in random places
+    int left[3] = {(long)b_size * overlap / 100};  // Both, a only, b only
+    left[1] = a_size - left[0];
+    left[2] = b_size - left[0];
+    int i = 0, k = 0;
+    for (int node = 0; left[0] + left[1] + left[2] > 0; node++) {
+        const int pick = bench_random(left[0] + left[1] + left[2]);
+        const int kind = pick < left[0]             ? 0
+                         : pick < left[0] + left[1] ? 1
+                                                    : 2;
+        left[kind]--;
+        if (kind != 2) {
+            a[i++] = node;
+        }
+        if (kind != 1) {
+            b[k++] = node;
+        }
+    }
+
+    const int repeat = get_max(BENCH_SIZE / a_size, 1);
+    double best[2] = {1e9, 1e9};
+    long count[2] = {0, 0};
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = bench_now();
+        for (int r = 0; r < repeat; r++) {
+            count[0] += array_combine(a, a_size, b, b_size, op, result);
+        }
+        best[0] = bench_min(best[0], bench_now() - start);
+
+        start = bench_now();
+        for (int r = 0; r < repeat; r++) {
+            count[1] +=
+                bench_merge_combine(a, a_size, b, b_size, op, result);
+        }
+        best[1] = bench_min(best[1], bench_now() - start);
+    }
+    if (count[0] != count[1]) {
+        fprintf(stderr, "Array combine results differ!\n");
+    }
+    char name[BENCH_NAME_SIZE];
+    snprintf(name, sizeof(name), "%s %d/%d %d%%",
+             op == BITSET_OR    ? "union"
+             : op == BITSET_AND ? "intersect"
+                                : "minus",
+             a_size, b_size, overlap);
+    bench_report(name, best[0], best[1]);
+    free(a);
+    free(b);
+    free(result);
+}
+
+/**
+ * @brief Compare array combine with plain merge over range of array sizes
+ * and overlaps
+ */
+void bench_array_sweep() {
+    const enum bitset_op ops[] = {BITSET_AND, BITSET_ANDNOT, BITSET_OR};
+    const int sizes[] = {10000, 100000, 1000000};
+    // Disjoint, quarter, half and identical arrays
+    const int overlaps[] = {0, 25, 50, 100};
+    for (int o = 0; o < 3; o++) {
+        for (int s = 0; s < 3; s++) {
+            for (int v = 0; v < 4; v++) {
+                bench_array_combine(ops[o], sizes[s], sizes[s], overlaps[v]);
+            }
+        }
+        // Skewed sizes
+        for (int s = 1; s < 3; s++) {
+            bench_array_combine(ops[o], sizes[s], sizes[s] / 100, 50);
+        }
+    }
+}
+#pragma endregion
+#pragma region ENTRY
+/*---------------------------------- ENTRY ----------------------------------*/
+
+int main() {
+    srand(1);
+    printf("%-32s %12s %12s %7s\n", "benchmark", "optimized", "plain",
+           "speedup");
+    bench_universe_sweep();
+    bench_set_sort();
+    bench_relation_sort();
+    bench_keys_sort();
+    bench_array_sweep();
+    return EXIT_SUCCESS;
+}
+#pragma endregion
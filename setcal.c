@@ -9,13 +9,26 @@
 #pragma region LIBRARIES
 /*-------------------------------- LIBRARIES --------------------------------*/
 
+#define _POSIX_C_SOURCE 200809L  // Expose POSIX file functions
+
 #include <ctype.h>    // Char functions
 #include <limits.h>   // Number limits
 #include <stdbool.h>  // Bool type
+#include <stdint.h>   // Fixed width integers
 #include <stdio.h>    // IO functions
 #include <stdlib.h>   // EXIT macros, memory allocation
 #include <string.h>   // String manipulation functions
 #include <time.h>     // For seeding random generator
+
+#include <fcntl.h>     // Opening files
+#include <pthread.h>   // Worker threads
+#include <sys/mman.h>  // Memory mapping of input file
+#include <sys/stat.h>  // File size
+#include <unistd.h>    // Reading and closing files
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>  // SIMD intrinsics for bitset kernels
+#endif
 #pragma endregion
 #pragma region CONSTANTS
 /*-------------------------------- CONSTANTS --------------------------------*/
@@ -23,13 +36,112 @@
 #define MAX_STRING_LENGTH 30
 #define STRING_BUFFER_SIZE MAX_STRING_LENGTH + 1  // +1 is for \0
 
+// Define maximum number of lines in file (not enforced when streaming)
+#define MAX_LINES 1000
+
+// Define argument that selects streaming from standard input
+#define STREAM_ARGUMENT "-"
+
+// Define argument that selects compilation into binary store
+#define COMPILE_ARGUMENT "--compile"
+
+// Define argument that sets output buffer size
+#define BUFFER_ARGUMENT "--buffer"
+
+// Define argument that sets worker thread count
+#define THREADS_ARGUMENT "--threads"
+
+// Define argument that prints result cache counters
+#define STATS_ARGUMENT "--stats"
+
+// Define argument that sets memory of sets and relations kept while streaming
+#define MEMORY_ARGUMENT "--memory"
+
+// Define default output buffer size (in bytes)
+#define OUTPUT_BUFFER_SIZE 65536
+
+// Define binary store identification
+#define BINARY_MAGIC "SETB"
+#define BINARY_MAGIC_SIZE 4
+#define BINARY_VERSION 2
+
 // Define maximum command arguments
 #define MAX_COMMAND_ARGUMENTS 4
 
+// Define universe hash table load factor (table size = node count * factor)
+#define UNIVERSE_TABLE_FACTOR 2
+
+// Define radix sort digit size and limits
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1)
+#define RADIX_MAX_PASSES 4  // Enough for all non-negative ints
+#define RADIX_MIN_SIZE 64   // Smaller arrays are sorted with qsort
+
+// Define number of elements small enough for relation nodes to be packed
+// into one 32-bit key (16 bits per element)
+#define RELATION_PACKED_LIMIT 65536
+
+// Define number of set or relation nodes compared at once by vectorized scans
+#if defined(__AVX2__)
+#define SCAN_LANES 8
+#elif defined(__SSE2__)
+#define SCAN_LANES 4
+#else
+#define SCAN_LANES 1
+#endif
+
+// Define size ratio from which nodes of small array set are looked up in much
+// bigger set instead of walking both sets
+#define GALLOP_RATIO 32
+
+// Define set density (size * factor >= max node) for sorting using bitmap
+#define SORT_DENSE_FACTOR 64
+
 // Define initial allocation sizes
 #define INITIAL_STORE_ALLOC 10
 #define INITIAL_SET_ALLOC 10
 #define INITIAL_RELATION_ALLOC 10
+#define INITIAL_INPUT_ALLOC 4096
+#define INITIAL_MEMO_ALLOC 64
+
+// Define default memory (in bytes) of sets and relations kept while
+// streaming, older ones are moved into temporary file
+#define STREAM_MEMORY_LIMIT 67108864
+
+// Define minimal size of set and relation lines (in bytes) worth parsing on
+// multiple threads
+#define PARALLEL_PARSE_MIN_SIZE 65536
+
+// Define size of matrix rows (in bytes) kept in cache together by closure
+#define CLOSURE_BLOCK_SIZE 262144
+
+// Define relation density (size * factor >= matrix words) for checking and
+// closing it on bit matrix, and matrix words always worth it, sparser
+// relations are worked with by their rows
+#define MATRIX_DENSE_FACTOR 64
+#define MATRIX_MIN_WORDS 65536
+
+// Define number of relation rows given to thread at once
+#define PARALLEL_CHUNK_ROWS 64
+
+// Define minimal number of relation pairs worth checking or searching on
+// multiple threads, and minimal number of matrix words worth closing on them
+#define PARALLEL_MIN_PAIRS 16384
+#define PARALLEL_MIN_WORDS 4096
+
+// Define minimal number of argument items of independent commands worth
+// computing on multiple threads
+#define PARALLEL_MIN_ITEMS 65536
+
+// Define size of store arena blocks (in bytes), bigger objects get own block,
+// and alignment of objects inside them
+#define ARENA_BLOCK_SIZE 1048576
+#define ARENA_ALIGNMENT 16
+
+// Define result of bool command that couldn't allocate memory, other results
+// are true and false
+#define BOOL_ALLOC_ERROR 2
 
 #pragma endregion
 #pragma region ENUMS
@@ -43,11 +155,40 @@ enum function_input {
     IN_SET_UNIVERSE,
     IN_RELATION,
     IN_RELATION_UNIVERSE,
+    IN_RELATION_THREADS,
     IN_RELATION_SET_SET,
     IN_ANY
 };
 
-enum function_output { OUT_VOID, OUT_BOOL, OUT_SET, OUT_RELATION, OUT_SELECT };
+enum function_output {
+    OUT_NUMBER,
+    OUT_BOOL,
+    OUT_SET,
+    OUT_RELATION,
+    OUT_SELECT
+};
+
+// Command operations follow order of function inputs
+enum opcode {
+    OP_PRINT_SET,
+    OP_PRINT_RELATION,
+    OP_SET,
+    OP_SET_SET,
+    OP_SET_UNIVERSE,
+    OP_RELATION,
+    OP_RELATION_UNIVERSE,
+    OP_RELATION_THREADS,
+    OP_RELATION_SET_SET,
+    OP_ANY,
+    OP_INVALID,
+    OP_HALT
+};
+
+enum set_layout { SET_ARRAY, SET_BITSET, SET_RUNS };
+
+enum relation_layout { RELATION_PAIRS, RELATION_PACKED, RELATION_COLUMNS };
+
+enum bitset_op { BITSET_OR, BITSET_AND, BITSET_ANDNOT };
 #pragma endregion
 #pragma region STRUCTS
 /*--------------------------------- STRUCTS ---------------------------------*/
@@ -55,13 +196,35 @@ enum function_output { OUT_VOID, OUT_BOOL, OUT_SET, OUT_RELATION, OUT_SELECT };
 // Struct to keep track of universe
 struct universe {
     int size;                           // Universe size
-    char (*nodes)[STRING_BUFFER_SIZE];  // Array of strings
+    char* names;     // All names stored one after another (not terminated)
+    int* offsets;    // Start of each name, offsets[size] is end of last name
+    int* table;      // Hash table of node indexes
+    int table_size;  // Hash table size (power of two)
+};
+
+// Struct to keep track of run of consecutive set nodes
+struct set_run {
+    int start;  // First node
+    int end;    // Node after last node
 };
 
 // Struct to keep track of one set
 struct set {
-    int size;    // Set size
-    int* nodes;  // Set nodes
+    int size;                // Set size
+    enum set_layout layout;  // Set layout
+    int* nodes;              // Sorted set nodes (array layout)
+    uint64_t* bits;          // Set nodes as bits (bitset layout)
+    int words;               // Bitset size in 64-bit words
+    struct set_run* runs;    // Sorted runs of nodes (run-length layout)
+    int run_count;           // Number of runs
+};
+
+// Struct to iterate over runs of consecutive nodes of any set layout
+struct run_cursor {
+    struct set* s;  // Iterated set
+    int index;      // Position of next run inside set storage
+    int start;      // First node of current run
+    int end;        // Node after last node of current run
 };
 
 // Struct to keep track of one node inside relation
@@ -73,7 +236,13 @@ struct relation_node {
 // Struct to keep track of one relation
 struct relation {
     int size;                     // Relation size
-    struct relation_node* nodes;  // Relation nodes
+    enum relation_layout layout;  // Relation layout
+    struct relation_node* nodes;  // Relation nodes - sorted (pairs layout)
+    uint32_t* keys;               // Nodes as a << 16 | b - sorted (packed)
+    int* first;                   // First elements - sorted (columns)
+    int* second;                  // Second elements of same nodes (columns)
+    int* rows;                    // First node of each row (row_count + 1)
+    int row_count;                // Number of rows (highest first item + 1)
 };
 
 // Struct to keep track of one command
@@ -95,6 +264,56 @@ struct command_def {
 struct store_node {
     enum store_node_type type;  // Store node type
     void* obj;                  // Pointer to node
+    bool in_arena;              // Node is owned by store arena
+    int version;                // Number of times node was replaced
+};
+
+// Struct to keep track of one block of arena memory
+struct arena_block {
+    struct arena_block* next;  // Previously allocated block
+    size_t size;               // Usable block size
+    size_t used;               // Number of used bytes
+};
+
+// Struct for bump allocator that frees all its objects at once
+struct arena {
+    struct arena_block* head;  // Block used for new allocations
+};
+
+// Struct for buffered output writer
+struct output {
+    FILE* fp;     // Destination stream
+    char* data;   // Buffer
+    size_t size;  // Buffer size
+    size_t used;  // Number of bytes waiting in buffer
+};
+
+// Struct to keep track of one cached command result
+struct memo_entry {
+    int type;                             // Command type, -1 for free slot
+    int args[MAX_COMMAND_ARGUMENTS];      // Function argument lines
+    int versions[MAX_COMMAND_ARGUMENTS];  // Argument node versions
+    void* result;                         // Result object or value
+};
+
+// Struct for cache of command results (open addressing)
+struct memo {
+    struct memo_entry* entries;  // Hash table
+    int size;                    // Table size (power of two)
+    int count;                   // Number of used entries
+    bool disabled;               // Results are neither stored nor looked up
+    long hits;                   // Number of reused results
+    long misses;                 // Number of computed results
+};
+
+// Struct for sets and relations moved into temporary file while streaming
+struct spill {
+    FILE* file;       // Temporary file, NULL when not streaming
+    long* offsets;    // File offset of every line, -1 when not written yet
+    int allocated;    // Allocated offsets
+    size_t resident;  // Bytes of sets and relations kept in memory
+    size_t limit;     // Bytes of sets and relations that can be kept
+    size_t trigger;   // Resident bytes that start moving lines out
 };
 
 // Struct to keep track of every node inside store
@@ -104,6 +323,143 @@ struct store {
     struct universe* universe;        // Universe
     struct set* empty_set;            // Empty set instance
     struct relation* empty_relation;  // Empty relation instance
+    int threads;                      // Worker thread count
+    bool schedule;                    // Run independent commands on threads
+    struct output output;             // Output writer
+    struct arena arena;               // Memory of store nodes
+    struct memo memo;                 // Cache of command results
+    struct spill spill;               // Lines moved out while streaming
+};
+
+// Struct to keep track of whole input
+struct input {
+    char* data;   // Input content
+    size_t size;  // Input size
+    bool mapped;  // Content is memory mapped (otherwise allocated)
+};
+
+// Struct to keep track of one line inside input
+struct line {
+    const char* start;  // First character of line
+    const char* end;    // End of line (without newline)
+};
+
+// Struct to share work items between threads
+struct work_queue {
+    pthread_mutex_t lock;  // Lock protecting members below
+    int next;              // Next work item to be taken
+    int end;               // Index after last work item
+    bool failed;           // Some work item failed, no more items are given
+};
+
+// Struct for parsing data lines on multiple threads
+struct parse_job {
+    struct work_queue queue;  // Indexes of lines to be parsed
+    struct line* lines;       // All lines
+    struct store* store;      // Store, parsed lines are stored at same index
+};
+
+// Struct to keep track of command planned by scheduler
+struct scheduled_command {
+    struct memo_entry key;               // Cache key
+    void* args[MAX_COMMAND_ARGUMENTS];   // Function arguments
+    int sources[MAX_COMMAND_ARGUMENTS];  // Commands computing arguments, -1
+                                         // when argument is ready
+    enum store_node_type type;  // Type of node replacing command line,
+                                // COMMAND when line isn't replaced
+    int level;     // Longest chain of dependencies, -1 when not computed
+    int alias;     // Earlier command computing same result, -1 when none
+    bool cached;   // Result was taken from cache or alias
+    void* result;  // Result of command function
+};
+
+// Struct for computing independent commands on multiple threads
+struct schedule_job {
+    struct work_queue queue;             // Indexes into order of one level
+    struct store* store;                 // Store
+    struct scheduled_command* commands;  // Lines of schedule from begin
+    int* order;                          // Computed commands sorted by level
+    int begin;                           // First line of schedule
+    int threads;                         // Threads of each level command
+    struct memo planned;  // Keys of computed commands, result is their index
+};
+
+// Struct for one instruction of compiled command program
+struct instruction {
+    enum opcode op;                   // Operation
+    bool checked;                     // Argument types are checked when run
+    bool jumps;                       // Command can jump, so it runs alone
+    int args[MAX_COMMAND_ARGUMENTS];  // Indexes of argument nodes
+    struct command* command;          // Command, NULL when line is printed
+    const struct command_def* def;    // Command definition
+};
+
+// Struct for store lines compiled into instructions
+struct program {
+    struct instruction* code;  // Instruction of every line and halt
+    int size;                  // Number of instructions
+};
+
+// Struct for adding block of closure rows into other rows on multiple threads
+struct closure_job {
+    struct work_queue queue;  // Chunks of matrix rows to be updated
+    struct bit_matrix* m;     // Matrix
+    int begin;                // First row of block
+    int end;                  // Row after last row of block
+};
+
+// Struct for closing relation by searching its rows on multiple threads
+struct closure_search_job {
+    struct work_queue queue;       // Chunks of relation rows to be searched
+    struct relation* r;            // Relation
+    int bound;                     // Highest element + 1
+    struct relation_node** nodes;  // Closure nodes of each chunk - sorted
+    int* sizes;                    // Number of closure nodes of each chunk
+};
+
+// Struct for checking transitivity on multiple threads
+struct transitive_job {
+    struct work_queue queue;  // Chunks of relation rows to be checked
+    struct relation* r;       // Relation, failed queue means not transitive
+    struct bit_matrix* m;     // Matrix of relation, NULL when rows are used
+    const int* index;         // Matrix row of each element
+};
+
+// Struct for header of compiled binary store
+struct binary_header {
+    char magic[BINARY_MAGIC_SIZE];  // File identification
+    int version;                    // Format version
+    int universe_size;              // Universe size
+    int names_size;                 // Size of universe names
+    int store_size;                 // Store size
+};
+
+// Struct for header of one node inside compiled binary store
+struct binary_node {
+    int type;    // Store node type
+    int size;    // Set or relation size (unused for commands)
+    int layout;  // Set or relation layout (unused for commands)
+    int count;   // Bitset words or run count (unused unless set isn't array)
+};
+
+// Struct for parsed program arguments
+struct options {
+    char* input;         // Input file name (STREAM_ARGUMENT for stdin)
+    char* compile;       // Binary store file name, NULL when not compiling
+    size_t buffer_size;  // Output buffer size
+    int threads;         // Worker thread count, 0 when not set
+    bool stats;          // Print cache counters when done
+    size_t memory;       // Memory of sets and relations kept while streaming
+};
+
+// Struct for square matrix of bits, used as relation adjacency matrix
+struct bit_matrix {
+    int size;        // Number of rows and columns
+    int words;       // Row size in 64-bit words
+    uint64_t* bits;  // Rows stored one after another
+    int* elements;   // Element of each row and column - sorted
+    bool* has_out;   // Row has any bit set
+    bool* has_in;    // Column has any bit set
 };
 
 // Struct for select command result
@@ -148,21 +504,300 @@ int compare_rel_nodes(const void* a, const void* b) {
 }
 
 /**
- * @brief Sort set
+ * @brief Function to compare two packed relation nodes - for qsort
+ * @param a Pointer to first key
+ * @param b Pointer to second key
+ * @return Negative, zero or positive number when first key is smaller, same
+ * or bigger
+ */
+int compare_keys(const void* a, const void* b) {
+    const uint32_t x = *(const uint32_t*)a;
+    const uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Count trailing zero bits
+ * @param x Number, must not be 0
+ * @return Index of lowest set bit
+ */
+int count_trailing_zeros(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int count = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+/**
+ * @brief Get number of radix passes needed for numbers up to max
+ * @param max Maximal number
+ * @return Number of passes
+ */
+int radix_passes(uint32_t max) {
+    int passes = 1;
+    while (passes < RADIX_MAX_PASSES && (max >> (RADIX_BITS * passes)) > 0) {
+        passes++;
+    }
+    return passes;
+}
+
+/**
+ * @brief Sort items by one radix digit of number inside them (stable)
+ *
+ * Items are made of 32-bit words, one of the words is sorted by.
+ * @param src Source items
+ * @param dst Destination
+ * @param size Item count
+ * @param words Number of words of one item
+ * @param key Index of word sorted by inside item
+ * @param shift Digit shift
+ * @param check Check for repeated items (only valid in last pass)
+ * @return False when repeated item was found
+ */
+bool radix_pass(const uint32_t* src,
+                uint32_t* dst,
+                int size,
+                int words,
+                int key,
+                int shift,
+                bool check) {
+    int start[RADIX_SIZE] = {0};
+    int pos[RADIX_SIZE];
+    // Count digits and find bucket starts
+    for (int i = 0; i < size; i++) {
+        start[(src[i * words + key] >> shift) & RADIX_MASK]++;
+    }
+    for (int d = 0, sum = 0; d < RADIX_SIZE; d++) {
+        const int count = start[d];
+        start[d] = pos[d] = sum;
+        sum += count;
+    }
+    // Scatter, bucket contents are sorted after last pass so repeated items
+    // end up next to each other inside bucket
+    bool unique = true;
+    for (int i = 0; i < size; i++) {
+        const uint32_t* item = &src[i * words];
+        const int d = (item[key] >> shift) & RADIX_MASK;
+        const int at = pos[d]++;
+        uint32_t* to = &dst[at * words];
+        bool same = check && at > start[d];
+        for (int w = 0; w < words; w++) {
+            same = same && to[w - words] == item[w];
+            to[w] = item[w];
+        }
+        unique = unique && !same;
+    }
+    return unique;
+}
+
+/**
+ * @brief Sort items with LSD radix sort by numbers inside them
+ *
+ * Keys are given from least significant, every key gets as many passes as
+ * its maximum needs.
+ * @param items Items made of 32-bit words, sorted in place
+ * @param tmp Buffer for items
+ * @param size Item count
+ * @param words Number of words of one item
+ * @param keys Indexes of words sorted by inside item
+ * @param maxes Maximum of every key
+ * @param count Number of keys
+ * @return False when repeated item was found
+ */
+bool radix_sort(uint32_t* items,
+                uint32_t* tmp,
+                int size,
+                int words,
+                const int* keys,
+                const uint32_t* maxes,
+                int count) {
+    uint32_t* src = items;
+    uint32_t* dst = tmp;
+    bool unique = true;
+    for (int k = 0; k < count; k++) {
+        const int passes = radix_passes(maxes[k]);
+        for (int p = 0; p < passes; p++) {
+            const bool last = k == count - 1 && p == passes - 1;
+            unique = radix_pass(src, dst, size, words, keys[k],
+                                p * RADIX_BITS, last);
+            uint32_t* swap = src;
+            src = dst;
+            dst = swap;
+        }
+    }
+    // Result has to end up in items
+    if (src != items) {
+        memcpy(items, src, sizeof(uint32_t) * words * size);
+    }
+    return unique;
+}
+
+/**
+ * @brief Sort set using presence bitmap (for sets dense in their range)
+ * @param s Set
+ * @param max Maximal set node
+ * @param seen Zeroed bitmap with at least max + 1 bits
+ * @return False when set contains repeated node
+ */
+bool set_bitmap_sort(struct set* s, int max, uint64_t* seen) {
+    bool unique = true;
+    for (int i = 0; i < s->size; i++) {
+        const uint64_t bit = (uint64_t)1 << (s->nodes[i] % 64);
+        unique = unique && (seen[s->nodes[i] / 64] & bit) == 0;
+        seen[s->nodes[i] / 64] |= bit;
+    }
+    // Read nodes back in ascending order, repeated nodes are written once
+    for (int w = 0, k = 0; w <= max / 64; w++) {
+        for (uint64_t bits = seen[w]; bits != 0; bits &= bits - 1) {
+            s->nodes[k++] = w * 64 + count_trailing_zeros(bits);
+        }
+    }
+    return unique;
+}
+
+/**
+ * @brief Sort set with qsort (used for tiny sets)
  * @param s Set
- * @return Sorted set (ascending)
+ * @return False when set contains repeated node
  */
-void set_sort(struct set* s) {
+bool set_qsort(struct set* s) {
     qsort(s->nodes, s->size, sizeof(int), compare_num_nodes);
+    for (int i = 1; i < s->size; i++) {
+        if (s->nodes[i] == s->nodes[i - 1]) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
- * @brief Sort relation
+ * @brief Sort set
+ *
+ * Uses counting (bitmap) sort for sets dense in their range and LSD radix
+ * sort otherwise. Repeated nodes are found during sorting.
+ * @param s Set
+ * @retval true - Set is sorted (ascending)
+ * @retval false - Set contains repeated node
+ */
+bool set_sort(struct set* s) {
+    if (s->size < RADIX_MIN_SIZE) {
+        return set_qsort(s);
+    }
+
+    int max = 0;
+    for (int i = 0; i < s->size; i++) {
+        max = s->nodes[i] > max ? s->nodes[i] : max;
+    }
+
+    // Bitmap is cheaper to scan than radix passes over dense sets
+    if ((long)s->size * SORT_DENSE_FACTOR >= max) {
+        uint64_t* seen = calloc(max / 64 + 1, sizeof(uint64_t));
+        if (seen != NULL) {
+            bool unique = set_bitmap_sort(s, max, seen);
+            free(seen);
+            return unique;
+        }
+    }
+
+    int* tmp = malloc(sizeof(int) * s->size);
+    if (tmp == NULL) {
+        return set_qsort(s);
+    }
+    // Nodes are non-negative, so they sort same as unsigned words
+    const int key = 0;
+    const uint32_t max_key = max;
+    bool unique = radix_sort((uint32_t*)s->nodes, (uint32_t*)tmp, s->size, 1,
+                             &key, &max_key, 1);
+    free(tmp);
+    return unique;
+}
+
+/**
+ * @brief Sort relation with qsort (used for tiny relations)
  * @param r Relation
- * @return Sorted relation (ascending)
+ * @return False when relation contains repeated node
  */
-void relation_sort(struct relation* r) {
+bool relation_qsort(struct relation* r) {
     qsort(r->nodes, r->size, sizeof(struct relation_node), compare_rel_nodes);
+    for (int i = 1; i < r->size; i++) {
+        if (compare_rel_nodes(&r->nodes[i], &r->nodes[i - 1]) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Sort packed relation nodes
+ *
+ * Keys keep order of nodes, so they are sorted as plain numbers.
+ * @param keys Packed nodes
+ * @param size Node count
+ * @retval true - Nodes are sorted (ascending)
+ * @retval false - Nodes contain repeated node
+ */
+bool keys_sort(uint32_t* keys, int size) {
+    uint32_t max = 0;
+    for (int i = 0; i < size; i++) {
+        max = keys[i] > max ? keys[i] : max;
+    }
+
+    uint32_t* tmp = size < RADIX_MIN_SIZE ? NULL : malloc(sizeof(*tmp) * size);
+    if (tmp == NULL) {
+        qsort(keys, size, sizeof(uint32_t), compare_keys);
+        for (int i = 1; i < size; i++) {
+            if (keys[i] == keys[i - 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    const int key = 0;
+    bool unique = radix_sort(keys, tmp, size, 1, &key, &max, 1);
+    free(tmp);
+    return unique;
+}
+
+/**
+ * @brief Sort relation
+ *
+ * Uses LSD radix sort, first by second numbers then by first numbers.
+ * Repeated nodes are found during sorting.
+ * @param r Relation in pairs or packed layout
+ * @retval true - Relation is sorted (ascending)
+ * @retval false - Relation contains repeated node
+ */
+bool relation_sort(struct relation* r) {
+    if (r->layout == RELATION_PACKED) {
+        return keys_sort(r->keys, r->size);
+    }
+    if (r->size < RADIX_MIN_SIZE) {
+        return relation_qsort(r);
+    }
+
+    int max_a = 0, max_b = 0;
+    for (int i = 0; i < r->size; i++) {
+        max_a = r->nodes[i].a > max_a ? r->nodes[i].a : max_a;
+        max_b = r->nodes[i].b > max_b ? r->nodes[i].b : max_b;
+    }
+
+    struct relation_node* tmp = malloc(sizeof(struct relation_node) * r->size);
+    if (tmp == NULL) {
+        return relation_qsort(r);
+    }
+    // Node is pair of words a and b, second numbers are less significant
+    const int keys[] = {1, 0};
+    const uint32_t maxes[] = {max_b, max_a};
+    bool unique = radix_sort((uint32_t*)r->nodes, (uint32_t*)tmp, r->size, 2,
+                             keys, maxes, 2);
+    free(tmp);
+    return unique;
 }
 #pragma endregion
 #pragma region HELPER FUNCTIONS
@@ -212,7 +847,7 @@ int get_max(int a, int b) {
  */
 struct set* get_set_from_universe(struct universe* universe) {
     // Allocate new set
-    struct set* set = malloc(sizeof(struct set));
+    struct set* set = calloc(1, sizeof(struct set));
     // Check if malloc failed
     if (set == NULL) {
         return NULL;
@@ -252,6 +887,8 @@ int get_argument_count(enum function_input input_type) {
             return 1;
         case IN_RELATION_UNIVERSE:
             return 1;
+        case IN_RELATION_THREADS:
+            return 1;
         case IN_RELATION_SET_SET:
             return 3;
         case IN_SET_SET:
@@ -262,6 +899,42 @@ int get_argument_count(enum function_input input_type) {
     return 1;
 }
 
+/**
+ * @brief Get expected type of argument from input type
+ * @param input_type Input type
+ * @param index Argument index
+ * @return RELATION for relation argument, SET otherwise
+ */
+enum store_node_type get_argument_type(enum function_input input_type,
+                                       int index) {
+    switch (input_type) {
+        case IN_RELATION:
+        case IN_RELATION_UNIVERSE:
+        case IN_RELATION_THREADS:
+        case IN_RELATION_SET_SET:
+            return index == 0 ? RELATION : SET;
+        default:
+            return SET;
+    }
+}
+
+/**
+ * @brief Get type of node replacing command line from output type
+ * @param output_type Output type
+ * @return SET or RELATION, COMMAND when line isn't replaced
+ */
+enum store_node_type get_result_type(enum function_output output_type) {
+    switch (output_type) {
+        case OUT_SET:
+        case OUT_SELECT:
+            return SET;
+        case OUT_RELATION:
+            return RELATION;
+        default:
+            return COMMAND;
+    }
+}
+
 /**
  * @brief Error printing function
  * @param message Error message
@@ -302,1475 +975,5351 @@ bool smart_realloc(void** block, int current, int* allocated, int item_size) {
 }
 
 #pragma endregion
-#pragma region VALIDATIONS
-/*------------------------------- VALIDATIONS -------------------------------*/
+#pragma region ARENA
+/*---------------------------------- ARENA ----------------------------------*/
 
 /**
- * @brief Check if universe is valid (doesn't contain reserved words, same
- * words)
- * @param u Universe
- * @retval true - Universe valid
- * @retval false - Universe invalid
+ * @brief Round size up to arena alignment
+ * @param size Size in bytes
+ * @return Aligned size
  */
-bool universe_valid(struct universe* u) {
-    // Define all illegal words inside universe
-    const char* illegal[] = {"empty",       "card",
-                             "complement",  "union",
-                             "intersect",   "minus",
-                             "subseteq",    "subset",
-                             "equals",      "reflexive",
-                             "symmetric",   "antisymmetric",
-                             "transitive",  "function",
-                             "domain",      "codomain",
-                             "injective",   "surjective",
-                             "bijective",   "closure_ref",
-                             "closure_sym", "closure_trans",
-                             "select",      "true",
-                             "false",       ""};
-    int size = sizeof(illegal) / sizeof(illegal[0]);
+size_t arena_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
 
-    // Loop around all elements inside universe
-    for (int i = 0; i < u->size; i++) {
-        // Loop around all illegal words
-        for (int j = 0; j < size; j++) {
-            if (strcmp(u->nodes[i], illegal[j]) == 0) {
-                return error("Illegal word inside universe!\n");
-            }
-        }
-        // Check for repeated word
-        for (int j = i + 1; j < u->size; j++) {
-            if (strcmp(u->nodes[i], u->nodes[j]) == 0) {
-                return error("Repeated word inside universe!\n");
-            }
-        }
+/**
+ * @brief Get start of block memory
+ * @param block Arena block
+ * @return First usable byte of block
+ */
+char* arena_block_data(struct arena_block* block) {
+    return (char*)block + arena_size(sizeof(struct arena_block));
+}
+
+/**
+ * @brief Allocate memory from arena, it is freed only with whole arena
+ * @param a Arena
+ * @param size Size in bytes
+ * @return Aligned memory, NULL when allocation failed
+ */
+void* arena_alloc(struct arena* a, size_t size) {
+    size = arena_size(size);
+
+    // Bump allocate from current block when it has enough space
+    struct arena_block* block = a->head;
+    if (block != NULL && block->size - block->used >= size) {
+        void* data = arena_block_data(block) + block->used;
+        block->used += size;
+        return data;
+    }
+
+    // Big objects get own block, so current block can be still used
+    const bool own = size > ARENA_BLOCK_SIZE / 4;
+    const size_t capacity = own ? size : ARENA_BLOCK_SIZE;
+    block = malloc(arena_size(sizeof(struct arena_block)) + capacity);
+    if (block == NULL) {
+        return NULL;
     }
-    // Universe is valid if everything went well
-    return true;
+    block->size = capacity;
+    block->used = size;
+    if (own && a->head != NULL) {
+        block->next = a->head->next;
+        a->head->next = block;
+    } else {
+        block->next = a->head;
+        a->head = block;
+    }
+    return arena_block_data(block);
 }
 
 /**
- * @brief Check if set is valid
- * @param s Set - sorted
- * @retval true - Set valid
- * @retval false - Set invalid
+ * @brief Copy array into memory reserved inside arena allocation
+ * @param pos Position inside arena allocation, moved after copied data
+ * @param data Copied data
+ * @param size Size of data in bytes
+ * @return Copy of data, NULL when there is nothing to copy
  */
-bool set_valid(struct set* a) {
-    // Loop around all elements inside set
-    for (int i = 1; i < a->size; i++) {
-        // If last item is same as current then this set is invalid
-        if (a->nodes[i] == a->nodes[i - 1]) {
-            return error("Repeated item inside set!\n");
-        }
+void* arena_place(char** pos, const void* data, size_t size) {
+    if (data == NULL || size == 0) {
+        return NULL;
     }
-    // If we didn't find two same elements then this set is valid
-    return true;
+    void* copy = memcpy(*pos, data, size);
+    *pos += arena_size(size);
+    return copy;
 }
 
 /**
- * @brief Check if relation is valid
- * @param r Relation - sorted
- * @retval true - Relation valid
- * @retval false - Relation invalid
+ * @brief Free all memory allocated from arena
+ * @param a Arena
  */
-bool relation_valid(struct relation* r) {
-    // Loop around all elements inside relation
-    for (int i = 1; i < r->size; i++) {
-        // If last item is same as current then this relation is invalid
-        if (r->nodes[i].a == r->nodes[i - 1].a &&
-            r->nodes[i].b == r->nodes[i - 1].b) {
-            return error("Repeated item inside relation");
-        }
+void arena_release(struct arena* a) {
+    while (a->head != NULL) {
+        struct arena_block* next = a->head->next;
+        free(a->head);
+        a->head = next;
     }
-    // If we didn't find two same relation nodes then this set is valid
-    return true;
 }
 
+#pragma endregion
+#pragma region BITSETS
+/*--------------------------------- BITSETS ---------------------------------*/
+
 /**
- * @brief Check if arguments of command are valid
- * @param command command
- * @param store store
- * @param def command definition
- * @retval true - Command arguments valid
- * @retval false - Command arguments invalid
+ * @brief Count set bits
+ * @param x Number
+ * @return Number of set bits
  */
-bool command_arguments_valid(struct command* command,
-                             struct store* store,
-                             struct command_def def) {
-    // Argument points to non-existant line
-    for (int i = 0; i < command->argc; i++) {
-        if (store->size < command->args[i]) {
-            return false;
-        }
+int count_bits(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int count = 0;
+    for (; x != 0; x &= x - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+/**
+ * @brief Get bitset size for given number of bits
+ * @param size Number of bits
+ * @return Number of 64-bit words
+ */
+int bitset_words(int size) {
+    return (size + 63) / 64;
+}
+
+/**
+ * @brief Check if bit is set inside bitset
+ * @param bits Bitset
+ * @param i Bit index
+ * @return Value of bit
+ */
+bool bitset_test(const uint64_t* bits, int i) {
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+/**
+ * @brief Set range of bits
+ * @param bits Bitset
+ * @param start First bit
+ * @param end Bit after last bit
+ */
+void bitset_set_range(uint64_t* bits, int start, int end) {
+    while (start < end) {
+        const int offset = start % 64;
+        const int count = end - start < 64 - offset ? end - start : 64 - offset;
+        const uint64_t mask =
+            count == 64 ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1);
+        bits[start / 64] |= mask << offset;
+        start += count;
     }
+}
 
-    // Check argument count
-    int argument_count = get_argument_count(def.input);
-    if (def.output == OUT_BOOL) {
-        if (command->argc != argument_count &&
-            command->argc != argument_count + 1) {
-            return false;
-        }
-    } else if (def.output == OUT_SELECT) {
-        if (command->argc != 2) {
-            return false;
+/**
+ * @brief Find next bit with given value
+ * @param bits Bitset
+ * @param words Bitset size in words
+ * @param from First bit to check
+ * @param value Searched value
+ * @return Index of found bit, words * 64 when there is none
+ */
+int bitset_next(const uint64_t* bits, int words, int from, bool value) {
+    int w = from / 64;
+    if (w >= words) {
+        return words * 64;
+    }
+    uint64_t x = (value ? bits[w] : ~bits[w]) & (~(uint64_t)0 << (from % 64));
+    while (x == 0) {
+        if (++w >= words) {
+            return words * 64;
         }
-    } else {
-        if (command->argc != argument_count) {
+        x = value ? bits[w] : ~bits[w];
+    }
+    return w * 64 + count_trailing_zeros(x);
+}
+
+/**
+ * @brief Count runs of consecutive set bits
+ * @param bits Bitset
+ * @param words Bitset size in words
+ * @return Number of runs
+ */
+int bitset_run_count(const uint64_t* bits, int words) {
+    int count = 0;
+    uint64_t carry = 0;
+    for (int w = 0; w < words; w++) {
+        // Run starts at every set bit whose lower neighbour isn't set
+        count += count_bits(bits[w] & ~((bits[w] << 1) | carry));
+        carry = bits[w] >> 63;
+    }
+    return count;
+}
+
+/**
+ * @brief Combine two bitsets word by word
+ * @param dst Result bitset (can be same as one of operands)
+ * @param a First bitset
+ * @param b Second bitset
+ * @param words Bitset size in words
+ * @param op Operation
+ * @return Number of set bits in result
+ */
+int bitset_combine(uint64_t* dst,
+                   const uint64_t* a,
+                   const uint64_t* b,
+                   int words,
+                   enum bitset_op op) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= words; i += 4) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        const __m256i r = op == BITSET_OR    ? _mm256_or_si256(x, y)
+                          : op == BITSET_AND ? _mm256_and_si256(x, y)
+                                             : _mm256_andnot_si256(y, x);
+        _mm256_storeu_si256((__m256i*)(dst + i), r);
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= words; i += 2) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        const __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        const __m128i r = op == BITSET_OR    ? _mm_or_si128(x, y)
+                          : op == BITSET_AND ? _mm_and_si128(x, y)
+                                             : _mm_andnot_si128(y, x);
+        _mm_storeu_si128((__m128i*)(dst + i), r);
+    }
+#endif
+    // Remaining words (or everything without SIMD)
+    for (; i < words; i++) {
+        dst[i] = op == BITSET_OR    ? a[i] | b[i]
+                 : op == BITSET_AND ? a[i] & b[i]
+                                    : a[i] & ~b[i];
+    }
+
+    int count = 0;
+    for (i = 0; i < words; i++) {
+        count += count_bits(dst[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief Complement bitset
+ * @param dst Result bitset
+ * @param a Bitset
+ * @param size Number of valid bits (bits after it stay cleared)
+ */
+void bitset_complement(uint64_t* dst, const uint64_t* a, int size) {
+    const int words = bitset_words(size);
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    for (; i + 4 <= words; i += 4) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(x, ones));
+    }
+#elif defined(__SSE2__)
+    const __m128i ones = _mm_set1_epi32(-1);
+    for (; i + 2 <= words; i += 2) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(x, ones));
+    }
+#endif
+    for (; i < words; i++) {
+        dst[i] = ~a[i];
+    }
+    // Clear bits past the end
+    if (size % 64 != 0) {
+        dst[words - 1] &= ((uint64_t)1 << (size % 64)) - 1;
+    }
+}
+
+/**
+ * @brief Add bits of one bitset into another
+ * @param dst Bitset where bits are added
+ * @param src Added bitset
+ * @param words Bitset size in words
+ */
+void bitset_or(uint64_t* dst, const uint64_t* src, int words) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= words; i += 4) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(dst + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(x, y));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= words; i += 2) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(dst + i));
+        const __m128i y = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(x, y));
+    }
+#endif
+    for (; i < words; i++) {
+        dst[i] |= src[i];
+    }
+}
+
+/**
+ * @brief Check if all bits of first bitset are set in second bitset
+ * @param a First bitset
+ * @param b Second bitset
+ * @param words Bitset size in words
+ * @retval true - a is subset of b (or equal)
+ * @retval false - a has bit that isn't in b
+ */
+bool bitset_subseteq(const uint64_t* a, const uint64_t* b, int words) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= words; i += 4) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        // Tests that (~y & x) is zero
+        if (!_mm256_testc_si256(y, x)) {
             return false;
         }
     }
-    // Check if argument types match input types
-    switch (def.input) {
-        case IN_SET:
-            return store->nodes[command->args[0] - 1].type != RELATION;
-        case IN_SET_UNIVERSE:
-            return store->nodes[command->args[0] - 1].type != RELATION;
-        case IN_SET_SET:
-            return store->nodes[command->args[0] - 1].type != RELATION &&
-                   store->nodes[command->args[1] - 1].type != RELATION;
-        case IN_RELATION:
-            return store->nodes[command->args[0] - 1].type != SET;
-        case IN_RELATION_UNIVERSE:
-            return store->nodes[command->args[0] - 1].type != SET;
-        case IN_RELATION_SET_SET:
-            return store->nodes[command->args[0] - 1].type != SET &&
-                   store->nodes[command->args[1] - 1].type != RELATION &&
-                   store->nodes[command->args[2] - 1].type != RELATION;
-        case IN_ANY:
-            return true;
+#endif
+    for (; i < words; i++) {
+        if ((a[i] & ~b[i]) != 0) {
+            return false;
+        }
     }
-
     return true;
 }
+#pragma endregion
+#pragma region SET LAYOUTS
+/*------------------------------- SET LAYOUTS -------------------------------*/
 
 /**
- * @brief Check if store is valid (correct order of node types)
- * @param store Store
- * @retval true - Store valid
- * @retval false - Store invalid
+ * @brief Get next run of consecutive nodes from set of any layout
+ * @param c Cursor
+ * @retval true - Run was found
+ * @retval false - There are no more runs
  */
-bool store_valid(struct store* store) {
-    // Ensure good order of node types
-    bool s_or_r_found = false, c_found = false;
-    for (int i = 1; i < store->size; i++) {
-        enum store_node_type type = store->nodes[i].type;
-        // Sets or relations can be only after universe or each other
-        if (type == SET || type == RELATION) {
-            if (c_found) {
+bool run_cursor_next(struct run_cursor* c) {
+    struct set* s = c->s;
+    switch (s->layout) {
+        case SET_ARRAY:
+            if (c->index >= s->size) {
+                return false;
+            }
+            c->start = s->nodes[c->index++];
+            c->end = c->start + 1;
+            // Join following consecutive nodes
+            while (c->index < s->size && s->nodes[c->index] == c->end) {
+                c->index++;
+                c->end++;
+            }
+            return true;
+        case SET_BITSET:
+            c->start = bitset_next(s->bits, s->words, c->index, true);
+            if (c->start >= s->words * 64) {
                 return false;
             }
-            s_or_r_found = true;
-            // Commands can only be after set or relation or command
-        } else if (type == COMMAND) {
-            if (!s_or_r_found) {
+            c->end = bitset_next(s->bits, s->words, c->start, false);
+            c->index = c->end;
+            return true;
+        case SET_RUNS:
+            if (c->index >= s->run_count) {
                 return false;
             }
-            c_found = true;
-        }
+            c->start = s->runs[c->index].start;
+            c->end = s->runs[c->index++].end;
+            return true;
     }
-    // Ensure all types of nodes are present and the line limit
-    // wasn't exceeded
-    return s_or_r_found && c_found && (store->size <= 1000);
+    return false;
 }
-#pragma endregion
-#pragma region PRINT FUNCTIONS
-/*----------------------------- PRINT FUNCTIONS -----------------------------*/
 
 /**
- * @brief Print bool value
- * @param b bool to be printed
+ * @brief Count runs of consecutive nodes inside set
+ * @param s Set
+ * @return Number of runs
  */
-void print_bool(bool b) {
-    printf(b ? "true\n" : "false\n");
+int set_run_count(struct set* s) {
+    if (s->layout == SET_RUNS) {
+        return s->run_count;
+    }
+    if (s->layout == SET_BITSET) {
+        return bitset_run_count(s->bits, s->words);
+    }
+    int count = s->size > 0;
+    for (int i = 1; i < s->size; i++) {
+        count += s->nodes[i] != s->nodes[i - 1] + 1;
+    }
+    return count;
 }
 
 /**
- * @brief Print set
- * @param a Set
- * @param u Universe
+ * @brief Set bits of all set nodes
+ * @param s Set
+ * @param bits Cleared bitset covering all set nodes
  */
-void print_set(struct set* a, struct universe* u, bool is_universe) {
-    // Indicate we are printing set or universe
-    printf(is_universe ? "U" : "S");
-    // Loop around all nodes inside set
-    for (int i = 0; i < a->size; i++) {
-        // Print each node inside set
-        printf(" %s", u->nodes[a->nodes[i]]);
+void set_fill_bits(struct set* s, uint64_t* bits) {
+    struct run_cursor c = {s, 0, 0, 0};
+    while (run_cursor_next(&c)) {
+        bitset_set_range(bits, c.start, c.end);
     }
-    printf("\n");
 }
 
 /**
- * @brief Print relation
- * @param r Relation
- * @param u Universe
+ * @brief Free set content and leave set without any layout storage
+ * @param s Set
  */
-void print_relation(struct relation* r, struct universe* u) {
-    // Indicate we are printing relation
-    printf("R");
-    // Loop around all nodes inside relation
-    for (int i = 0; i < r->size; i++) {
-        // Print each node inside relation
-        printf(" (%s %s)", u->nodes[r->nodes[i].a], u->nodes[r->nodes[i].b]);
-    }
-    printf("\n");
+void set_clear_storage(struct set* s) {
+    free(s->nodes);
+    free(s->bits);
+    free(s->runs);
+    s->nodes = NULL;
+    s->bits = NULL;
+    s->runs = NULL;
+    s->words = 0;
+    s->run_count = 0;
 }
-#pragma endregion
-#pragma region SET FUNCTIONS
-/*------------------------------ SET FUNCTIONS ------------------------------*/
 
 /**
- * @brief Check if set is empty
- * @param a Set
- * @retval true - Set is empty
- * @retval false - Set is not empty
+ * @brief Allocate empty set in bitset layout
+ * @param words Bitset size in words
+ * @return Set, NULL when allocation failed
  */
-bool set_empty(struct set* a) {
-    return a->size == 0;
+struct set* set_create_bitset(int words) {
+    struct set* s = calloc(1, sizeof(struct set));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->layout = SET_BITSET;
+    s->words = words;
+    s->bits = calloc(get_max(words, 1), sizeof(uint64_t));
+    if (s->bits == NULL) {
+        free(s);
+        return NULL;
+    }
+    return s;
 }
 
 /**
- * @brief Prints size of set
- * @param a Set
+ * @brief Convert set into bitset layout
+ * @param s Set
+ * @param words Bitset size in words
+ * @retval true - Set was converted
+ * @retval false - Allocation failed, set wasn't changed
  */
-void set_card(struct set* a) {
-    printf("%d\n", a->size);
+bool set_to_bitset(struct set* s, int words) {
+    uint64_t* bits = calloc(get_max(words, 1), sizeof(uint64_t));
+    if (bits == NULL) {
+        return false;
+    }
+    set_fill_bits(s, bits);
+    set_clear_storage(s);
+    s->bits = bits;
+    s->words = words;
+    s->layout = SET_BITSET;
+    return true;
 }
 
 /**
- * @brief Create set complement
- * @param a Set - sorted
- * @param u Universe
- * @return Pointer to new set
+ * @brief Convert set into array layout
+ * @param s Set
+ * @retval true - Set was converted
+ * @retval false - Allocation failed, set wasn't changed
  */
-struct set* set_complement(struct set* a, struct universe* u) {
-    // Memory allocation for set
-    struct set* complement = malloc(sizeof(struct set));
-    if (complement == NULL) {
-        return NULL;
+bool set_to_array(struct set* s) {
+    int* nodes = malloc(sizeof(int) * get_max(s->size, 1));
+    if (nodes == NULL) {
+        return false;
     }
-    complement->size = 0;
-
-    int size = (u->size - a->size) * sizeof(int);
-    // If set is same as universe => complement is empty
-    if (size == 0) {
-        complement->nodes = NULL;
-        return complement;
+    struct run_cursor c = {s, 0, 0, 0};
+    for (int k = 0; run_cursor_next(&c);) {
+        for (int node = c.start; node < c.end; node++) {
+            nodes[k++] = node;
+        }
     }
+    set_clear_storage(s);
+    s->nodes = nodes;
+    s->layout = SET_ARRAY;
+    return true;
+}
 
-    // Memory allocation for set nodes
-    complement->nodes = malloc(size);
-    if (complement->nodes == NULL) {
-        free(complement);
-        return NULL;
+/**
+ * @brief Convert set into run-length layout
+ * @param s Set
+ * @retval true - Set was converted
+ * @retval false - Allocation failed, set wasn't changed
+ */
+bool set_to_runs(struct set* s) {
+    const int count = set_run_count(s);
+    struct set_run* runs = malloc(sizeof(struct set_run) * get_max(count, 1));
+    if (runs == NULL) {
+        return false;
     }
-
-    // Loop around all universe nodes
-    for (int i = 0, k = 0; i < u->size; i++) {
-        // If universe node is in given set => skip adding that node into
-        // complement
-        if (k < a->size && i == a->nodes[k]) {
-            k++;
-            continue;
-        }
-        // Adds universe node into complement
-        complement->nodes[complement->size++] = i;
+    struct run_cursor c = {s, 0, 0, 0};
+    for (int k = 0; run_cursor_next(&c); k++) {
+        runs[k].start = c.start;
+        runs[k].end = c.end;
     }
-    return complement;
+    set_clear_storage(s);
+    s->runs = runs;
+    s->run_count = count;
+    s->layout = SET_RUNS;
+    return true;
 }
 
 /**
- * @brief Find union of two sets
- * @param a First set - sorted
- * @param b Second set - sorted
- * @return Pointer to new set
+ * @brief Convert set into layout that takes the least memory
+ *
+ * Layout is only an optimization, when conversion fails set stays as it is.
+ * @param s Set
+ * @param words Universe bitset size in words, 0 when bitset can't be used
  */
-struct set* set_union(struct set* a, struct set* b) {
-    // Memory allocation for set
-    struct set* s_union = malloc(sizeof(struct set));
-    if (s_union == NULL) {
-        return NULL;
-    }
-    s_union->size = 0;
+void set_pack(struct set* s, int words) {
+    const size_t array_cost = sizeof(int) * s->size;
+    const size_t bitset_cost = sizeof(uint64_t) * words;
+    const size_t runs_cost = sizeof(struct set_run) * set_run_count(s);
 
-    int size = (a->size + b->size) * sizeof(int);
-    // If sets are empty => union is empty
-    if (size == 0) {
-        s_union->nodes = NULL;
-        return s_union;
+    // Array wins ties, it is the simplest layout
+    enum set_layout layout = SET_ARRAY;
+    size_t cost = array_cost;
+    if (words > 0 && bitset_cost < cost) {
+        layout = SET_BITSET;
+        cost = bitset_cost;
     }
-
-    // Memory allocation for set nodes
-    s_union->nodes = malloc(size);
-    if (s_union->nodes == NULL) {
-        free(s_union);
-        return NULL;
+    if (runs_cost < cost) {
+        layout = SET_RUNS;
     }
 
-    // Starting indexes of sets A and B
-    int i = 0, k = 0;
-    // Loop around all nodes from set A
-    while (i < a->size) {
-        // Check if k index is smaller than size of set B and if node from set B
-        // is smaller or equal to node from set A => add node from set B
-        if (k < b->size && b->nodes[k] <= a->nodes[i]) {
-            // If nodes are equal => increment index of set A
-            if (b->nodes[k] == a->nodes[i]) {
-                i++;
-            }
-            // Adds node from set B
-            s_union->nodes[s_union->size++] = b->nodes[k++];
-            continue;
-        }
-        // Adds node from set A
-        s_union->nodes[s_union->size++] = a->nodes[i++];
+    if (layout == s->layout) {
+        return;
     }
-    // Adds remaining nodes from set B
-    while (k < b->size) {
-        s_union->nodes[s_union->size++] = b->nodes[k++];
+    switch (layout) {
+        case SET_ARRAY:
+            set_to_array(s);
+            break;
+        case SET_BITSET:
+            set_to_bitset(s, words);
+            break;
+        case SET_RUNS:
+            set_to_runs(s);
+            break;
     }
-
-    return s_union;
 }
 
 /**
- * @brief Find intersect of two sets
- * @param a Set - sorted
- * @param b Set - sorted
- * @return Pointer to new set
+ * @brief Get set as bitset, other layouts are converted into temporary bitset
+ * @param s Set
+ * @param words Bitset size in words
+ * @param tmp Temporary bitset which has to be freed by caller (or NULL)
+ * @return Bitset, NULL when allocation failed
  */
-struct set* set_intersect(struct set* a, struct set* b) {
-    // Memory allocation for set
-    struct set* intersect = malloc(sizeof(struct set));
-    if (intersect == NULL) {
-        return NULL;
+const uint64_t* set_bits(struct set* s, int words, uint64_t** tmp) {
+    *tmp = NULL;
+    if (s->layout == SET_BITSET) {
+        return s->bits;
     }
-    intersect->size = 0;
-
-    int size = get_min(a->size, b->size) * sizeof(int);
-    // If one of the sets is empty => intersect is empty
-    if (size == 0) {
-        intersect->nodes = NULL;
-        return intersect;
+    *tmp = calloc(get_max(words, 1), sizeof(uint64_t));
+    if (*tmp != NULL) {
+        set_fill_bits(s, *tmp);
     }
+    return *tmp;
+}
 
-    // Memory allocation for set nodes
-    intersect->nodes = malloc(size);
-    if (intersect->nodes == NULL) {
-        free(intersect);
-        return NULL;
-    }
+/**
+ * @brief Get membership bitmap of set keyed by universe index
+ * @param s Set
+ * @param size Number of elements bitmap has to cover
+ * @param tmp Temporary bitmap which has to be freed by caller (or NULL)
+ * @return Bitmap, NULL when allocation failed
+ */
+const uint64_t* set_membership(struct set* s, int size, uint64_t** tmp) {
+    // Set nodes have to fit into bitmap as well
+    int bound = s->layout == SET_BITSET ? s->words * 64 : 0;
+    if (s->layout == SET_ARRAY && s->size > 0) {
+        bound = s->nodes[s->size - 1] + 1;
+    } else if (s->layout == SET_RUNS && s->run_count > 0) {
+        bound = s->runs[s->run_count - 1].end;
+    }
+    return set_bits(s, bitset_words(get_max(size, bound)), tmp);
+}
 
-    // Starting indexes of sets A and B
-    int i = 0, k = 0;
-    // Loop until one of the indexers is same as size of it's set
-    while (i < a->size && k < b->size) {
-        // If nodes are the same => add node to interset and increment indexers
-        if (a->nodes[i] == b->nodes[k]) {
-            intersect->nodes[intersect->size++] = a->nodes[i++];
-            k++;
-        }
-        // If node from set A is smaller than node from set B => increment index
-        // of set A, else increment index of set b
-        else if (a->nodes[i] < b->nodes[k]) {
-            i++;
+/**
+ * @brief Find first node not smaller than given node using exponential search
+ * @param nodes Sorted nodes
+ * @param from Index where search starts
+ * @param size Number of nodes
+ * @param node Searched node
+ * @return Index of first node at or after from not smaller than node, size
+ * when there is no such node
+ */
+int array_gallop(const int* nodes, int from, int size, int node) {
+    if (from >= size || nodes[from] >= node) {
+        return from;
+    }
+    // Double step while nodes are smaller, node is inside last step then
+    int low = from, step = 1;
+    while (step < size - low && nodes[low + step] < node) {
+        low += step;
+        step *= 2;
+    }
+    int high = get_min(low + step, size);
+    low++;
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (nodes[middle] < node) {
+            low = middle + 1;
         } else {
-            k++;
+            high = middle;
         }
     }
-    return intersect;
+    return low;
 }
 
 /**
- * @brief Finds difference between two sets
- * @param a Set - sorted
- * @param b Set - sorted
- * @return Pointer to new set
+ * @brief Check if set contains node
+ * @param s Set
+ * @param node Node
+ * @retval true - Node is inside set
+ * @retval false - Node isn't inside set
  */
-struct set* set_minus(struct set* a, struct set* b) {
-    // Memory allocation for set
-    struct set* minus = malloc(sizeof(struct set));
-    if (minus == NULL) {
-        return NULL;
-    }
-    minus->size = 0;
-
-    int size = a->size * sizeof(int);
-    // If set A is empty => minus is empty
-    if (size == 0) {
-        minus->nodes = NULL;
-        return minus;
-    }
-
-    // Memory allocation for set nodes
-    minus->nodes = malloc(size);
-    if (minus->nodes == NULL) {
-        free(minus);
-        return NULL;
-    }
-
-    // Starting indexes of sets A and B
-    int i = 0, k = 0;
-    // Loop around all nodes from set A
-    while (i < a->size) {
-        // Check if k index is smaller than size of set B and if node from set B
-        // is smaller or equal to node from set A => skip adding node
-        if (k < b->size && b->nodes[k] <= a->nodes[i]) {
-            // If nodes are equal => increment index of set A
-            if (b->nodes[k] == a->nodes[i]) {
-                i++;
+bool set_contains(struct set* s, int node) {
+    if (s->layout == SET_BITSET) {
+        return node < s->words * 64 && bitset_test(s->bits, node);
+    }
+    if (s->layout == SET_RUNS) {
+        // Binary search for last run starting at or before node
+        int low = 0, high = s->run_count;
+        while (low < high) {
+            const int middle = low + (high - low) / 2;
+            if (s->runs[middle].start <= node) {
+                low = middle + 1;
+            } else {
+                high = middle;
             }
-            // increment index of set A
-            k++;
-            continue;
         }
-        // Adds node from set A
-        minus->nodes[minus->size++] = a->nodes[i++];
+        return low > 0 && node < s->runs[low - 1].end;
+    }
+    // Binary search in sorted nodes
+    int low = 0, high = s->size;
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (s->nodes[middle] < node) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
     }
-    return minus;
+    return low < s->size && s->nodes[low] == node;
 }
 
 /**
- * @brief Set subseteq function
- * @param a Set - sorted
- * @param b Set - sorted
- * @retval true - Set a is subset of b or equal to b
- * @retval false - Set a isn't subset of b or equal to b
+ * @brief Check if set contains node, nodes have to be checked in ascending
+ * order
+ * @param s Set
+ * @param node Node
+ * @param from Position of previous node inside array set, starts at 0
+ * @retval true - Node is inside set
+ * @retval false - Node isn't inside set
  */
-bool set_subseteq(struct set* a, struct set* b) {
-    // Index of set A
-    int k = 0;
-    // Loop around all nodes from set B or until all nodes from set A were
-    // found in set B
-    for (int i = 0; i < b->size && k < a->size; i++) {
-        //  Check if node from set A is in set B => increment index of set A
-        if (b->nodes[i] == a->nodes[k]) {
-            k++;
-        }
+bool set_contains_next(struct set* s, int node, int* from) {
+    if (s->layout != SET_ARRAY) {
+        return set_contains(s, node);
     }
-    // If the index of set A is the same as size of set A => is subseteq
-    return (k == a->size);
+    *from = array_gallop(s->nodes, *from, s->size, node);
+    return *from < s->size && s->nodes[*from] == node;
 }
 
 /**
- * @brief Set subset function
- * @param a Set - sorted
- * @param b Set - sorted
- * @retval true - Set a is subset of b
- * @retval false - Set a isn't subset of b
+ * @brief Check if array set is so much smaller than other set that looking
+ * up its nodes is cheaper than walking other set
+ * @param small Set
+ * @param big Other set
+ * @retval true - Nodes of small set should be looked up
+ * @retval false - Sets should be walked together
  */
-bool set_subset(struct set* a, struct set* b) {
-    // Index of set A
-    int k = 0;
-    // Loop around all nodes from set B or until all nodes from set A were
-    // found in set B
-    for (int i = 0; i < b->size && k < a->size; i++) {
-        //  Check if node from set A is in set B => increment index of set A
-        if (b->nodes[i] == a->nodes[k]) {
-            k++;
-        }
-    }
-    // If the index of set A is the same as size of set A and size of set A and
-    // B are different => is subset
-    return (k == a->size) && (a->size != b->size);
+bool set_skewed(struct set* small, struct set* big) {
+    const int storage = big->layout == SET_BITSET ? big->words
+                        : big->layout == SET_RUNS ? big->run_count
+                                                  : big->size;
+    return small->layout == SET_ARRAY &&
+           (long)small->size * GALLOP_RATIO < storage;
 }
 
 /**
- * @brief Compare two sets
- * @param a First set - sorted
- * @param b Second set - sorted
- * @retval true - sets are equal
- * @retval false - sets aren't equal
+ * @brief Create set of array set nodes which are (or aren't) inside other set
+ * @param s Array set
+ * @param other Other set
+ * @param inside Keep nodes inside other set, otherwise nodes outside of it
+ * @return Pointer to new set, NULL when allocation failed
  */
-bool set_equals(struct set* a, struct set* b) {
-    // If sets have different sizes they are different
-    if (a->size != b->size) {
-        return false;
+struct set* set_filter(struct set* s, struct set* other, bool inside) {
+    struct set* result = calloc(1, sizeof(struct set));
+    if (result == NULL) {
+        return NULL;
     }
-
-    // Loop around all nodes
-    for (int i = 0; i < a->size; i++) {
-        // If any nodes differ sets are different
-        if (a->nodes[i] != b->nodes[i]) {
-            return false;
+    result->nodes = malloc(sizeof(int) * get_max(s->size, 1));
+    if (result->nodes == NULL) {
+        free(result);
+        return NULL;
+    }
+    for (int i = 0, from = 0; i < s->size; i++) {
+        if (set_contains_next(other, s->nodes[i], &from) == inside) {
+            result->nodes[result->size++] = s->nodes[i];
         }
     }
-
-    return true;
+    set_pack(result, 0);
+    return result;
 }
-#pragma endregion
-#pragma region RELATION FUNCTIONS
-/*--------------------------- RELATION FUNCTIONS ----------------------------*/
 
 /**
- * @brief Find out if relation is reflexive
- * @param r Relation - sorted
- * @param u Universe - sorted
- * @retval true - Relation is reflexive
- * @retval false - Relation isn't reflexive
+ * @brief Get node of set by its order
+ * @param s Set
+ * @param k Order of node (from 0), must be smaller than set size
+ * @return Node
  */
-bool relation_reflexive(struct relation* r, struct universe* u) {
-    bool reflex_for_i;
-
-    // Loop around all universe nodes
-    for (int i = 0; i < u->size; i++) {
-        reflex_for_i = false;
-
-        // Loop around all relation nodes
-        for (int j = 0; j < r->size; j++) {
-            // Look for relation nodes that have same value as current universe
-            // node
-            if (r->nodes[j].a == i) {
-                // If node is reflective, move on to next universe node
-                if (r->nodes[j].a == r->nodes[j].b) {
-                    reflex_for_i = true;
-                    break;
-                }
-                // Relation is sorted (ascending), we won't find a match again
-                // if the first relation node element is larger than current
-                // universe node
-            } else if (r->nodes[j].a > i) {
-                break;
-            }
-        }
-
-        if (!reflex_for_i) {
-            return false;
+int set_node_at(struct set* s, int k) {
+    if (s->layout == SET_ARRAY) {
+        return s->nodes[k];
+    }
+    if (s->layout == SET_RUNS) {
+        int r = 0;
+        while (s->runs[r].end - s->runs[r].start <= k) {
+            k -= s->runs[r].end - s->runs[r].start;
+            r++;
         }
+        return s->runs[r].start + k;
     }
+    // Skip whole words first
+    int w = 0;
+    while (count_bits(s->bits[w]) <= k) {
+        k -= count_bits(s->bits[w++]);
+    }
+    uint64_t bits = s->bits[w];
+    for (; k > 0; k--) {
+        bits &= bits - 1;
+    }
+    return w * 64 + count_trailing_zeros(bits);
+}
 
-    return true;
+/**
+ * @brief Find which nodes of block of sorted array are inside block of other
+ * sorted array, compares SCAN_LANES nodes of both arrays at once
+ * @param a Block of first array
+ * @param b Block of second array
+ * @return Mask with bit k set when a[k] is inside block of b
+ */
+unsigned array_block_matches(const int* a, const int* b) {
+#if defined(__AVX2__)
+    // Compare block of a with all rotations of block of b
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    const __m256i x = _mm256_loadu_si256((const __m256i*)a);
+    __m256i y = _mm256_loadu_si256((const __m256i*)b);
+    __m256i same = _mm256_cmpeq_epi32(x, y);
+    for (int r = 1; r < SCAN_LANES; r++) {
+        y = _mm256_permutevar8x32_epi32(y, rotate);
+        same = _mm256_or_si256(same, _mm256_cmpeq_epi32(x, y));
+    }
+    return _mm256_movemask_ps(_mm256_castsi256_ps(same));
+#elif defined(__SSE2__)
+    // Compare block of a with all rotations of block of b
+    const __m128i x = _mm_loadu_si128((const __m128i*)a);
+    __m128i y = _mm_loadu_si128((const __m128i*)b);
+    __m128i same = _mm_cmpeq_epi32(x, y);
+    for (int r = 1; r < SCAN_LANES; r++) {
+        y = _mm_shuffle_epi32(y, _MM_SHUFFLE(0, 3, 2, 1));
+        same = _mm_or_si128(same, _mm_cmpeq_epi32(x, y));
+    }
+    return _mm_movemask_ps(_mm_castsi128_ps(same));
+#else
+    return a[0] == b[0];
+#endif
 }
 
 /**
- * @brief Find out if relation is symmetric
+ * @brief Unite small sorted array with much bigger one, nodes of big array
+ * between nodes of small array are found by galloping and copied at once
+ * @param small Small array
+ * @param small_size Size of small array
+ * @param big Big array
+ * @param big_size Size of big array
+ * @param result Result array, there has to be space for both arrays
+ * @return Number of nodes in result
+ */
+int array_union_skewed(const int* small,
+                       int small_size,
+                       const int* big,
+                       int big_size,
+                       int* result) {
+    int count = 0, k = 0;
+    for (int i = 0; i < small_size; i++) {
+        const int next = array_gallop(big, k, big_size, small[i]);
+        memcpy(result + count, big + k, sizeof(int) * (next - k));
+        count += next - k;
+        k = next;
+        result[count++] = small[i];
+        // Same node is written only once
+        k += k < big_size && big[k] == small[i];
+    }
+    memcpy(result + count, big + k, sizeof(int) * (big_size - k));
+    return count + big_size - k;
+}
+
+/**
+ * @brief Combine two sorted arrays without repeated nodes
  *
- * @param r Relation - sorted
- * @retval true - Relation is symmetric
- * @retval false - Relation is not symmetric
+ * Intersection and difference compare whole blocks of both arrays, nodes
+ * of block of a are written once no later block of b can contain them.
+ * Union is merged without branches on node order, unless one array is much
+ * smaller.
+ * @param a First array
+ * @param a_size Size of first array
+ * @param b Second array
+ * @param b_size Size of second array
+ * @param op Operation
+ * @param result Result array, there has to be space for result nodes
+ * @return Number of nodes in result
  */
-bool relation_symmetric(struct relation* r) {
-    // Loop around all relation nodes
-    for (int i = 0; i < r->size; i++) {
-        // Loop around all relation nodes
-        for (int k = 0; k < r->size; k++) {
-            // If symmetric node is found => break
-            if (r->nodes[i].a == r->nodes[k].b &&
-                r->nodes[i].b == r->nodes[k].a) {
-                break;
-            }
-            // If the iteration in the last one => symmetric node wasn't found
-            // and relation is not symmetric
-            if (k + 1 == r->size) {
-                return false;
+int array_combine(const int* a,
+                  int a_size,
+                  const int* b,
+                  int b_size,
+                  enum bitset_op op,
+                  int* result) {
+    int count = 0, i = 0, k = 0;
+    if (op == BITSET_OR && (long)a_size * GALLOP_RATIO < b_size) {
+        return array_union_skewed(a, a_size, b, b_size, result);
+    }
+    if (op == BITSET_OR && (long)b_size * GALLOP_RATIO < a_size) {
+        return array_union_skewed(b, b_size, a, a_size, result);
+    }
+    if (op == BITSET_OR) {
+        while (i < a_size && k < b_size) {
+            const int x = a[i], y = b[k];
+            result[count++] = x <= y ? x : y;
+            i += x <= y;
+            k += y <= x;
+        }
+        // Copy rest of the unfinished array
+        for (; i < a_size; i++) {
+            result[count++] = a[i];
+        }
+        for (; k < b_size; k++) {
+            result[count++] = b[k];
+        }
+        return count;
+    }
+
+    const bool keep_found = op == BITSET_AND;
+    // Nodes of current block of a found inside blocks of b visited so far
+    unsigned found = 0;
+    while (SCAN_LANES > 1 && i + SCAN_LANES <= a_size &&
+           k + SCAN_LANES <= b_size) {
+        found |= array_block_matches(a + i, b + k);
+        const int last_a = a[i + SCAN_LANES - 1];
+        const int last_b = b[k + SCAN_LANES - 1];
+        if (last_a <= last_b) {
+            // Later blocks of b start after last node of block
+            unsigned keep = keep_found ? found : ~found;
+            keep &= (1u << SCAN_LANES) - 1;
+            for (; keep != 0; keep &= keep - 1) {
+                result[count++] = a[i + count_trailing_zeros(keep)];
             }
+            i += SCAN_LANES;
+            found = 0;
         }
+        k += last_b <= last_a ? SCAN_LANES : 0;
     }
-    return true;
+
+    // Rest is merged node by node, nodes found inside skipped blocks of b
+    // are known already
+    for (int lane = 0; i < a_size; i++, lane++) {
+        while (k < b_size && b[k] < a[i]) {
+            k++;
+        }
+        const bool inside = (lane < SCAN_LANES && (found >> lane & 1)) ||
+                            (k < b_size && b[k] == a[i]);
+        if (inside == keep_found) {
+            result[count++] = a[i];
+        }
+    }
+    return count;
 }
 
 /**
- * @brief Find out if relation is symmetric
- *
- * @param r Relation - sorted
- * @retval true - Relation is antisymmetric
- * @retval false - Relation is not antisymmetric
+ * @brief Combine two sets of any layout run by run
+ * @param a First set
+ * @param b Second set
+ * @param op Operation
+ * @param runs Result runs (NULL when only size is needed), there has to be
+ * space for runs of both sets
+ * @param run_count Number of result runs (can be NULL)
+ * @return Number of nodes in result
  */
-bool relation_antisymmetric(struct relation* r) {
-    // Loop around all relation nodes
-    for (int i = 0; i < r->size; i++) {
-        // Loop around all remaining nodes
-        for (int k = i + 1; k < r->size; k++) {
-            // If symmetric node is found => relation is not antisymmetric
-            if (r->nodes[i].a == r->nodes[k].b &&
-                r->nodes[i].b == r->nodes[k].a) {
-                return false;
+int runs_combine(struct set* a,
+                 struct set* b,
+                 enum bitset_op op,
+                 struct set_run* runs,
+                 int* run_count) {
+    struct run_cursor ca = {a, 0, INT_MAX, INT_MAX};
+    struct run_cursor cb = {b, 0, INT_MAX, INT_MAX};
+    // Exhausted cursor keeps empty run at INT_MAX
+    if (!run_cursor_next(&ca)) {
+        ca.start = ca.end = INT_MAX;
+    }
+    if (!run_cursor_next(&cb)) {
+        cb.start = cb.end = INT_MAX;
+    }
+
+    int size = 0, count = 0;
+    int pos = get_min(ca.start, cb.start);
+    // Sweep over boundaries of runs from both sets
+    while (pos < INT_MAX) {
+        const bool in_a = ca.start <= pos;
+        const bool in_b = cb.start <= pos;
+        const int next =
+            get_min(in_a ? ca.end : ca.start, in_b ? cb.end : cb.start);
+        const bool in_result = op == BITSET_OR    ? in_a || in_b
+                               : op == BITSET_AND ? in_a && in_b
+                                                  : in_a && !in_b;
+        if (in_result) {
+            size += next - pos;
+            if (runs != NULL && count > 0 && runs[count - 1].end == pos) {
+                runs[count - 1].end = next;
+            } else if (runs != NULL) {
+                runs[count].start = pos;
+                runs[count].end = next;
+                count++;
             }
         }
+        pos = next;
+        if (ca.end <= pos && !run_cursor_next(&ca)) {
+            ca.start = ca.end = INT_MAX;
+        }
+        if (cb.end <= pos && !run_cursor_next(&cb)) {
+            cb.start = cb.end = INT_MAX;
+        }
     }
-    return true;
+    if (run_count != NULL) {
+        *run_count = count;
+    }
+    return size;
 }
 
 /**
- * @brief Find out if relation is transitive
- *
- * @param r Relation - sorted
- * @retval true - Relation is transitive
- * @retval false - Relation is not transitive
+ * @brief Combine two sets where at least one is in bitset layout
+ * @param a First set
+ * @param b Second set
+ * @param op Operation
+ * @return Pointer to new set, NULL when allocation failed
  */
-bool relation_transitive(struct relation* r) {
-    // Transitive relation: (aRb & bRa) => aRc
+struct set* set_combine_bitsets(struct set* a,
+                                struct set* b,
+                                enum bitset_op op) {
+    const int words = a->layout == SET_BITSET ? a->words : b->words;
+    uint64_t *tmp_a, *tmp_b;
+    const uint64_t* bits_a = set_bits(a, words, &tmp_a);
+    const uint64_t* bits_b = set_bits(b, words, &tmp_b);
+    struct set* result = set_create_bitset(words);
+
+    if (bits_a != NULL && bits_b != NULL && result != NULL) {
+        result->size = bitset_combine(result->bits, bits_a, bits_b, words, op);
+        set_pack(result, words);
+    } else if (result != NULL) {
+        free(result->bits);
+        free(result);
+        result = NULL;
+    }
+    free(tmp_a);
+    free(tmp_b);
+    return result;
+}
 
-    // Loop around all relation nodes
-    for (int i = 0; i < r->size; i++) {
-        // Loop around all relation nodes
-        for (int j = 0; j < r->size; j++) {
-            // Looks for node that has second element same as current node (bRa)
-            if (r->nodes[i].b == r->nodes[j].a) {
-                // Loop around all relation nodes
-                for (int k = 0; k < r->size; k++) {
-                    // Looks for node that meets aRc
-                    if (r->nodes[i].a == r->nodes[k].a &&
-                        r->nodes[j].b == r->nodes[k].b) {
-                        break;
-                    }
-                    // If the iteration is the last one => aRc wasn't found and
-                    // relation is not transitive
-                    if (k + 1 == r->size) {
-                        return false;
-                    }
-                }
-            }
-        }
+/**
+ * @brief Combine two sets run by run, result takes the least memory
+ * @param a First set
+ * @param b Second set
+ * @param op Operation
+ * @param words Universe bitset size in words, 0 when bitset can't be used
+ * @return Pointer to new set, NULL when allocation failed
+ */
+struct set* set_combine_runs(struct set* a,
+                             struct set* b,
+                             enum bitset_op op,
+                             int words) {
+    struct set* result = calloc(1, sizeof(struct set));
+    if (result == NULL) {
+        return NULL;
     }
-    return true;
+    const int count = set_run_count(a) + set_run_count(b);
+    result->runs = malloc(sizeof(struct set_run) * get_max(count, 1));
+    if (result->runs == NULL) {
+        free(result);
+        return NULL;
+    }
+    result->layout = SET_RUNS;
+    result->size = runs_combine(a, b, op, result->runs, &result->run_count);
+    set_pack(result, words);
+    return result;
 }
 
+#pragma endregion
+#pragma region RELATION LAYOUTS
+/*---------------------------- RELATION LAYOUTS -----------------------------*/
+
 /**
- * @brief Find out if relation is a function
- *
- * @param r Relation - sorted
- * @retval true - Relation is a function
- * @retval false - Relation is not a function
+ * @brief Pack relation node into one key, keys keep order of nodes
+ * @param a First element
+ * @param b Second element
+ * @return Key
  */
-bool relation_function(struct relation* r) {
-    // Loops around all elemnts - 1
-    for (int i = 0; i < r->size - 1; i++) {
-        // If current node is same as next node => relation is not a function
-        if (r->nodes[i].a == r->nodes[i + 1].a) {
-            return false;
-        }
+uint32_t relation_key(int a, int b) {
+    return (uint32_t)a << 16 | (uint32_t)b;
+}
+
+/**
+ * @brief Get first element of relation node
+ * @param r Relation
+ * @param i Node index
+ * @return First element
+ */
+int relation_first(struct relation* r, int i) {
+    switch (r->layout) {
+        case RELATION_PACKED:
+            return (int)(r->keys[i] >> 16);
+        case RELATION_COLUMNS:
+            return r->first[i];
+        default:
+            return r->nodes[i].a;
     }
-    return true;
 }
 
 /**
- * @brief Relation domain function
- *
- * @param r Relation - sorted
- * @return Pointer to a new set
+ * @brief Get second element of relation node
+ * @param r Relation
+ * @param i Node index
+ * @return Second element
  */
-struct set* relation_domain(struct relation* r) {
-    // Memory allocation for set
-    struct set* domain = malloc(sizeof(struct set));
-    if (domain == NULL) {
-        return NULL;
+int relation_second(struct relation* r, int i) {
+    switch (r->layout) {
+        case RELATION_PACKED:
+            return (int)(r->keys[i] & 0xFFFF);
+        case RELATION_COLUMNS:
+            return r->second[i];
+        default:
+            return r->nodes[i].b;
     }
+}
 
-    // Memory allocation for set nodes
-    domain->nodes = malloc(sizeof(int) * r->size);
-    domain->size = 0;
+/**
+ * @brief Get relation node of any layout
+ * @param r Relation
+ * @param i Node index
+ * @return Node
+ */
+struct relation_node relation_node_at(struct relation* r, int i) {
+    const struct relation_node node = {relation_first(r, i),
+                                       relation_second(r, i)};
+    return node;
+}
 
-    // Checks if relation is empty => returns empty set
-    if (r->size == 0) {
-        return domain;
+/**
+ * @brief Get arrays holding relation nodes
+ * @param r Relation
+ * @param size Number of nodes arrays are sized for
+ * @param arrays Pointers to relation fields with arrays
+ * @param sizes Array sizes in bytes
+ * @return Number of arrays
+ */
+int relation_arrays(struct relation* r,
+                    int size,
+                    void** arrays[2],
+                    size_t sizes[2]) {
+    switch (r->layout) {
+        case RELATION_PACKED:
+            arrays[0] = (void**)&r->keys;
+            sizes[0] = sizeof(uint32_t) * size;
+            return 1;
+        case RELATION_COLUMNS:
+            arrays[0] = (void**)&r->first;
+            arrays[1] = (void**)&r->second;
+            sizes[0] = sizes[1] = sizeof(int) * size;
+            return 2;
+        default:
+            arrays[0] = (void**)&r->nodes;
+            sizes[0] = sizeof(struct relation_node) * size;
+            return 1;
     }
+}
 
-    // Check malloc
-    if (domain->nodes == NULL) {
-        free(domain);
-        return NULL;
-    }
+/**
+ * @brief Choose relation layout for elements, pairs are only used while
+ * relation is being built
+ * @param bound Highest element + 1
+ * @return Relation layout
+ */
+enum relation_layout relation_fitting_layout(int bound) {
+    return bound <= RELATION_PACKED_LIMIT ? RELATION_PACKED : RELATION_COLUMNS;
+}
 
-    // Puts the first element of the first relation node to set
-    domain->nodes[domain->size++] = r->nodes[0].a;
-    for (int i = 1; i < r->size; i++) {
-        // If the last element is not the same as current element => adds
-        // element in set
-        if (r->nodes[i].a != r->nodes[i - 1].a) {
-            domain->nodes[domain->size++] = r->nodes[i].a;
+/**
+ * @brief Allocate arrays of relation layout
+ * @param r Relation with layout set and without arrays
+ * @param capacity Maximal number of nodes
+ * @retval true - Arrays were allocated
+ * @retval false - Allocation failed (no array is left allocated)
+ */
+bool relation_alloc_arrays(struct relation* r, int capacity) {
+    void** arrays[2];
+    size_t sizes[2];
+    const int count =
+        relation_arrays(r, get_max(capacity, 1), arrays, sizes);
+
+    bool ok = true;
+    for (int k = 0; k < count; k++) {
+        *arrays[k] = malloc(sizes[k]);
+        ok = ok && *arrays[k] != NULL;
+    }
+    if (!ok) {
+        for (int k = 0; k < count; k++) {
+            free(*arrays[k]);
+            *arrays[k] = NULL;
         }
     }
-    return domain;
+    return ok;
 }
 
 /**
- * @brief Relation codomain function
- *
- * @param r Relation - sorted
- * @retval Set pointer - relation codomain set
- * @retval NULL - Function failed
+ * @brief Allocate empty relation
+ * @param capacity Maximal number of nodes
+ * @param layout Relation layout
+ * @return Relation, NULL when allocation failed
  */
-struct set* relation_codomain(struct relation* r) {
-    // Memory allocation for set
-    struct set* codomain = malloc(sizeof(struct set));
-    if (codomain == NULL) {
+struct relation* relation_create(int capacity, enum relation_layout layout) {
+    struct relation* r = calloc(1, sizeof(struct relation));
+    if (r == NULL) {
         return NULL;
     }
-
-    // Memory allocation for set nodes
-    codomain->nodes = malloc(sizeof(int) * r->size);
-    codomain->size = 0;
-
-    // Checks if relation is empty => returns empty set
-    if (r->size == 0) {
-        return codomain;
+    r->layout = layout;
+    if (!relation_alloc_arrays(r, capacity)) {
+        free(r);
+        return NULL;
     }
+    return r;
+}
 
-    // Check malloc
-    if (codomain->nodes == NULL) {
-        return NULL;
+/**
+ * @brief Add node after last node of relation
+ * @param r Relation with enough capacity
+ * @param a First element
+ * @param b Second element
+ */
+void relation_append(struct relation* r, int a, int b) {
+    switch (r->layout) {
+        case RELATION_PACKED:
+            r->keys[r->size] = relation_key(a, b);
+            break;
+        case RELATION_COLUMNS:
+            r->first[r->size] = a;
+            r->second[r->size] = b;
+            break;
+        default:
+            r->nodes[r->size].a = a;
+            r->nodes[r->size].b = b;
+            break;
     }
+    r->size++;
+}
 
-    // Loop around all nodes
-    for (int i = 0; i < r->size; i++) {
-        bool found = false;
-        // Find out if current element is already in the codomain set
-        for (int k = 0; k < codomain->size; k++) {
-            if (r->nodes[i].b == codomain->nodes[k]) {
-                found = true;
-                break;
-            }
-        }
-        // If element wasn't found in codomain => adds element
-        if (!found) {
-            codomain->nodes[codomain->size++] = r->nodes[i].b;
-        }
+/**
+ * @brief Convert relation built as pairs into given layout
+ * @param r Relation in pairs layout
+ * @param layout New layout
+ */
+void relation_convert(struct relation* r, enum relation_layout layout) {
+    if (r->layout != RELATION_PAIRS || layout == RELATION_PAIRS) {
+        return;
     }
-    set_sort(codomain);
-    return codomain;
+    struct relation converted = {.layout = layout};
+    // Relation stays usable in pairs layout without memory
+    if (!relation_alloc_arrays(&converted, r->size)) {
+        return;
+    }
+    for (int i = 0; i < r->size; i++) {
+        relation_append(&converted, r->nodes[i].a, r->nodes[i].b);
+    }
+    free(r->nodes);
+    r->nodes = NULL;
+    r->layout = layout;
+    r->keys = converted.keys;
+    r->first = converted.first;
+    r->second = converted.second;
 }
 
 /**
- * @brief Find out if r only contains elements of set a and set b
- *
+ * @brief Find which nodes start new row (differ from previous node in first
+ * element), compares SCAN_LANES nodes at once
  * @param r Relation
- * @param a Set A
- * @param b Set B
- * @retval true - Relation only contains elements from sets
- * @retval false - Relation contains element(s) that aren't in sets
+ * @param i First compared node (at least 1)
+ * @return Mask with bit k set when node i + k starts new row
  */
-bool relation_valid_sets(struct relation* r, struct set* a, struct set* b) {
-    for (int i = 0; i < r->size; i++) {
-        // Find if set a contains first element
-        bool found = false;
-        for (int j = 0; j < a->size; j++) {
-            if (r->nodes[i].a == a->nodes[j]) {
-                found = true;
-                break;
-            }
+unsigned relation_row_starts(struct relation* r, int i) {
+#if defined(__AVX2__)
+    if (r->layout == RELATION_COLUMNS) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(r->first + i));
+        const __m256i y =
+            _mm256_loadu_si256((const __m256i*)(r->first + i - 1));
+        const __m256i same = _mm256_cmpeq_epi32(x, y);
+        return ~_mm256_movemask_ps(_mm256_castsi256_ps(same)) & 0xFF;
+    }
+    if (r->layout == RELATION_PACKED) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(r->keys + i));
+        const __m256i y =
+            _mm256_loadu_si256((const __m256i*)(r->keys + i - 1));
+        const __m256i same = _mm256_cmpeq_epi32(_mm256_srli_epi32(x, 16),
+                                                _mm256_srli_epi32(y, 16));
+        return ~_mm256_movemask_ps(_mm256_castsi256_ps(same)) & 0xFF;
+    }
+#elif defined(__SSE2__)
+    if (r->layout == RELATION_COLUMNS) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(r->first + i));
+        const __m128i y = _mm_loadu_si128((const __m128i*)(r->first + i - 1));
+        const __m128i same = _mm_cmpeq_epi32(x, y);
+        return ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xF;
+    }
+    if (r->layout == RELATION_PACKED) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(r->keys + i));
+        const __m128i y = _mm_loadu_si128((const __m128i*)(r->keys + i - 1));
+        const __m128i same =
+            _mm_cmpeq_epi32(_mm_srli_epi32(x, 16), _mm_srli_epi32(y, 16));
+        return ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xF;
+    }
+#endif
+    // Pairs layout (or everything without SIMD)
+    unsigned mask = 0;
+    for (int k = 0; k < SCAN_LANES; k++) {
+        mask |= (unsigned)(relation_first(r, i + k) !=
+                           relation_first(r, i + k - 1))
+                << k;
+    }
+    return mask;
+}
+
+/**
+ * @brief Count nodes of relation with same first and second element
+ * @param r Relation
+ * @return Number of diagonal nodes
+ */
+int relation_diagonal_count(struct relation* r) {
+    int count = 0, i = 0;
+#if defined(__AVX2__)
+    if (r->layout == RELATION_COLUMNS) {
+        for (; i + 8 <= r->size; i += 8) {
+            const __m256i x =
+                _mm256_loadu_si256((const __m256i*)(r->first + i));
+            const __m256i y =
+                _mm256_loadu_si256((const __m256i*)(r->second + i));
+            const __m256i same = _mm256_cmpeq_epi32(x, y);
+            count += count_bits(_mm256_movemask_ps(_mm256_castsi256_ps(same)));
         }
-        if (!found) {
-            return false;
+    } else if (r->layout == RELATION_PACKED) {
+        const __m256i low = _mm256_set1_epi32(0xFFFF);
+        for (; i + 8 <= r->size; i += 8) {
+            const __m256i x =
+                _mm256_loadu_si256((const __m256i*)(r->keys + i));
+            const __m256i same = _mm256_cmpeq_epi32(_mm256_srli_epi32(x, 16),
+                                                    _mm256_and_si256(x, low));
+            count += count_bits(_mm256_movemask_ps(_mm256_castsi256_ps(same)));
         }
-
-        // Find if set b contains first element
-        found = false;
-        for (int j = 0; j < b->size; j++) {
-            if (r->nodes[i].b == b->nodes[j]) {
-                found = true;
-                break;
-            }
+    }
+#elif defined(__SSE2__)
+    if (r->layout == RELATION_COLUMNS) {
+        for (; i + 4 <= r->size; i += 4) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(r->first + i));
+            const __m128i y = _mm_loadu_si128((const __m128i*)(r->second + i));
+            const __m128i same = _mm_cmpeq_epi32(x, y);
+            count += count_bits(_mm_movemask_ps(_mm_castsi128_ps(same)));
         }
-        if (!found) {
-            return false;
+    } else if (r->layout == RELATION_PACKED) {
+        const __m128i low = _mm_set1_epi32(0xFFFF);
+        for (; i + 4 <= r->size; i += 4) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(r->keys + i));
+            const __m128i same = _mm_cmpeq_epi32(_mm_srli_epi32(x, 16),
+                                                 _mm_and_si128(x, low));
+            count += count_bits(_mm_movemask_ps(_mm_castsi128_ps(same)));
         }
     }
-    return true;
+#endif
+    // Remaining nodes (or everything without SIMD)
+    for (; i < r->size; i++) {
+        count += relation_first(r, i) == relation_second(r, i);
+    }
+    return count;
 }
 
+#pragma endregion
+#pragma region THREADING
+/*-------------------------------- THREADING --------------------------------*/
+
 /**
- * @brief Find out if relation is injective
- *
- * @param r Relation - sorted
- * @retval true - Relation is injective
- * @retval false - Relation is not injective
+ * @brief Get number of online processors
+ * @return Processor count, at least 1
  */
-bool relation_injective(struct relation* r, struct set* a, struct set* b) {
-    if (!relation_valid_sets(r, a, b)) {
-        return false;
-    }
-    // First elements must be unique
-    if (!relation_function(r)) {
-        return false;
-    }
-
-    // All elements from a must be in a
-    return a->size == r->size;
+int get_processor_count() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count < 1 ? 1 : (int)count;
 }
 
 /**
- * @brief Find out if relation is surjective
- *
- * @param r Relation - sorted
- * @return true - Relation is surjective
- * @return false - Relation is not surjective
+ * @brief Init work queue
+ * @param queue Work queue
+ * @param begin First work item
+ * @param end Index after last work item
+ * @retval true - Queue was initialized
+ * @retval false - Lock couldn't be created
  */
-bool relation_surjective(struct relation* r, struct set* a, struct set* b) {
-    if (!relation_valid_sets(r, a, b)) {
-        return false;
-    }
-    // All elements from set b have to be in relation (second position)
-    // There can be duplicates as well
-    int unique_second_elements = 0;
-    for (int i = 0; i < r->size; i++) {
-        bool duplicate = false;
-        for (int j = i - 1; j >= 0; j--) {
-            if (r->nodes[i].b == r->nodes[j].b) {
-                duplicate = true;
-                break;
-            }
-        }
-        if (!duplicate) {
-            unique_second_elements++;
-        }
-    }
-    return unique_second_elements == b->size;
+bool work_queue_init(struct work_queue* queue, int begin, int end) {
+    queue->next = begin;
+    queue->end = end;
+    queue->failed = false;
+    return pthread_mutex_init(&queue->lock, NULL) == 0;
 }
 
 /**
- * @brief Find out if relation is bijective
- *
- * @param r Relation - sorted
- * @retval true - Relation is bijective
- * @return false - Relation is not bijective
+ * @brief Destroy work queue
+ * @param queue Work queue
  */
-bool relation_bijective(struct relation* r, struct set* a, struct set* b) {
-    // Relation is bijective if relation is injective and surjective
-    return relation_injective(r, a, b) && relation_surjective(r, a, b);
+void work_queue_destroy(struct work_queue* queue) {
+    pthread_mutex_destroy(&queue->lock);
 }
 
 /**
- * @brief Create reflexive relation closure
- * @param r Relation - sorted
- * @param u Universe - sorted
- * @retval Relation pointer - Reflexive relation closure
- * @retval NULL - Function failed
+ * @brief Take next work item from queue
+ * @param queue Work queue
+ * @return Work item, -1 when there is no work left or some item failed
  */
-struct relation* relation_closure_ref(struct relation* r, struct universe* u) {
-    // Allocate memory for result relation, which is a copy of original
-    struct relation* result = malloc(sizeof(struct relation));
-    if (result == NULL) {
-        return NULL;
-    }
-
-    result->nodes = malloc(sizeof(struct relation_node) * (r->size));
-    if (result->nodes == NULL) {
-        return NULL;
-    }
-    result->size = r->size;
-
-    // Copy original relation to result
-    for (int i = 0; i < result->size; i++) {
-        result->nodes[i] = r->nodes[i];
-    }
-
-    // Look for reflexive nodes for each universe element
-    // if we don't find any, then add it to result
-    bool reflex_for_i;
-    for (int i = 0; i < u->size; i++) {
-        reflex_for_i = false;
-
-        for (int j = 0; j < r->size; j++) {
-            if (r->nodes[j].a == i) {
-                if (r->nodes[j].a == r->nodes[j].b) {
-                    reflex_for_i = true;
-                    break;
-                }
-            } else if (r->nodes[j].a > i) {
-                break;
-            }
-        }
-        // Add reflexive element for current universe node
-        if (!reflex_for_i) {
-            result->size += 1;
-            result->nodes = srealloc(
-                result->nodes, sizeof(struct relation_node) * result->size);
-            if (result->nodes == NULL) {
-                return NULL;
-            }
-            result->nodes[result->size - 1].a = i;
-            result->nodes[result->size - 1].b = i;
-        }
-    }
-    relation_sort(result);
-
-    return result;
+int work_queue_take(struct work_queue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    int item = queue->failed || queue->next >= queue->end ? -1 : queue->next++;
+    pthread_mutex_unlock(&queue->lock);
+    return item;
 }
 
 /**
- * @brief Create symmetric relation closure
- * @param r Relation - sorted
- * @param u Universe - sorted
- * @retval Relation pointer - Symmetric relation closure
- * @retval NULL - Function failed
+ * @brief Mark work item as failed, remaining items won't be given out
+ * @param queue Work queue
  */
-struct relation* relation_closure_sym(struct relation* r) {
-    // Create a copy of original relation where additional nodes can be added
-    struct relation* result = malloc(sizeof(struct relation));
-    if (result == NULL) {
-        return NULL;
-    }
-    result->nodes = malloc(sizeof(struct relation_node) * r->size);
-    if (result->nodes == NULL) {
-        return NULL;
-    }
-    result->size = r->size;
-
-    for (int i = 0; i < result->size; i++) {
-        result->nodes[i] = r->nodes[i];
-    }
-
-    for (int i = 0; i < r->size; i++) {
-        for (int k = 0; k < r->size; k++) {
-            if (r->nodes[i].a == r->nodes[k].b &&
-                r->nodes[i].b == r->nodes[k].a) {
-                break;
-            }
-            // If relation is missing node to be symmetric, add that node
-            if (k + 1 == r->size) {
-                result->size += 1;
-                result->nodes = srealloc(
-                    result->nodes, sizeof(struct relation_node) * result->size);
-                if (result->nodes == NULL) {
-                    return NULL;
-                }
-                result->nodes[result->size - 1].a = r->nodes[i].b;
-                result->nodes[result->size - 1].b = r->nodes[i].a;
-            }
-        }
-    }
-    relation_sort(result);
-
-    return result;
+void work_queue_fail(struct work_queue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->failed = true;
+    pthread_mutex_unlock(&queue->lock);
 }
 
 /**
- * @brief Create transitive relation closure
- * @param r Relation - sorted
- * @param u Universe - sorted
- * @retval Relation pointer - Transitive relation closure
- * @retval NULL - Function failed
+ * @brief Run worker on multiple threads and wait until all of them finish
+ *
+ * Calling thread works as one of the workers. When thread can't be created,
+ * work is done by threads that are already running.
+ * @param worker Worker function
+ * @param job Argument passed to all workers
+ * @param threads Number of threads
  */
-struct relation* relation_closure_trans(struct relation* r) {
-    // Create a copy of the original relation
-    struct relation* result = malloc(sizeof(struct relation));
-    if (result == NULL) {
-        return NULL;
-    }
-    result->nodes = malloc(sizeof(struct relation_node) * r->size);
-    if (result->nodes == NULL) {
-        return NULL;
-    }
-    result->size = r->size;
-
-    for (int i = 0; i < result->size; i++) {
-        result->nodes[i] = r->nodes[i];
-    }
-
-    // Compare second element of i with all first elements
-    for (int i = 0; i < result->size; i++) {
-        for (int j = 0; j < result->size; j++) {
-            // If aRb and bRc, look if aRc
-            if (result->nodes[i].b == result->nodes[j].a) {
-                for (int k = 0; k < result->size; k++) {
-                    // If aRc, go to the next i
-                    if (result->nodes[i].a == result->nodes[k].a &&
-                        result->nodes[j].b == result->nodes[k].b) {
-                        break;
-                    }
-                    // If we don't find a node that says aRc,
-                    // add that node as the last one
-                    if (k + 1 == result->size) {
-                        result->size += 1;
-                        result->nodes = srealloc(
-                            result->nodes,
-                            sizeof(struct relation_node) * result->size);
-                        if (result->nodes == NULL) {
-                            return NULL;
-                        }
-                        result->nodes[result->size - 1].a = result->nodes[i].a;
-                        result->nodes[result->size - 1].b = result->nodes[j].b;
-
-                        // Start highest for loop over (i = 0 after i++)
-                        i = -1;
-                        break;
-                    }
-                }
-                break;
-            }
-        }
-    }
-    relation_sort(result);
-
-    return result;
+void run_parallel(void* (*worker)(void*), void* job, int threads) {
+    pthread_t* ids = threads > 1 ? malloc(sizeof(pthread_t) * threads) : NULL;
+    int created = 0;
+    while (ids != NULL && created < threads - 1 &&
+           pthread_create(&ids[created], NULL, worker, job) == 0) {
+        created++;
+    }
+    worker(job);
+    for (int i = 0; i < created; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    free(ids);
 }
 
 #pragma endregion
-#pragma region SPECIAL COMMANDS
-/*---------------------------- SPECIAL COMMANDS -----------------------------*/
+#pragma region UNIVERSE LOOKUP
+/*----------------------------- UNIVERSE LOOKUP -----------------------------*/
 
 /**
- * @brief Select random item from set
- * @param s Set
+ * @brief Get name of universe element
  * @param u Universe
+ * @param i Element index
+ * @return Pointer to name (not terminated)
  */
-void select_random_from_set(struct set* s, struct select_result* result) {
-    // Check if set is empty
-    if (set_empty(s)) {
-        result->empty = true;
-        return;
-    }
-    // Get random index to set
-    int rand_index = rand() % s->size;
-
-    result->item = malloc(sizeof(struct set));
-    if (result->item == NULL) {
-        result->error = true;
-        return;
-    }
-    result->item->size = 1;
-    result->item->nodes = malloc(sizeof(int));
-    if (result->item->nodes == NULL) {
-        free(result->item);
-        result->error = true;
-        return;
-    }
-
-    result->item->nodes[0] = s->nodes[rand_index];
+const char* universe_name(struct universe* u, int i) {
+    return u->names + u->offsets[i];
 }
 
 /**
- * @brief Select random item from relation
- * @param r Relation
+ * @brief Get length of universe element name
  * @param u Universe
+ * @param i Element index
+ * @return Name length
  */
-void select_random_from_relation(struct relation* r,
-                                 struct select_result* result) {
-    // Check if relation is empty
-    if (r->size == 0) {
-        result->empty = true;
-        return;
-    }
-    // Get random index to relation
-    int rand_index = rand() % r->size;
-    // Find a, b in relation
-    struct relation_node node = r->nodes[rand_index];
-
-    result->item = malloc(sizeof(struct set));
-    if (result->item == NULL) {
-        result->error = true;
-        return;
-    }
-    result->item->size = 1;
-    result->item->nodes = malloc(sizeof(int));
-    if (result->item->nodes == NULL) {
-        free(result->item);
-        result->error = true;
-        return;
-    }
-
-    result->item->nodes[0] = rand() % 2 == 0 ? node.a : node.b;
+int universe_name_length(struct universe* u, int i) {
+    return u->offsets[i + 1] - u->offsets[i];
 }
 
 /**
- * @brief Select command
- * @param node Node from universe (set or relation)
+ * @brief Compare universe element name with string
  * @param u Universe
- * @return Select result
+ * @param i Element index
+ * @param name String (doesn't have to be terminated)
+ * @param length String length
+ * @retval true - Strings are same
+ * @retval false - Strings differ
  */
-struct select_result* select_command(struct store_node* node) {
-    struct select_result* result = malloc(sizeof(struct select_result));
-    if (result == NULL) {
-        return NULL;
-    }
-    result->empty = false;
-    result->error = false;
-    result->item = NULL;
-
-    if (node->type == SET) {
-        select_random_from_set(node->obj, result);
-    } else if (node->type == RELATION) {
-        select_random_from_relation(node->obj, result);
-    } else {
-        result->empty = true;
-    }
-
-    return result;
+bool universe_name_equals(struct universe* u,
+                          int i,
+                          const char* name,
+                          int length) {
+    return universe_name_length(u, i) == length &&
+           memcmp(universe_name(u, i), name, length) == 0;
 }
-#pragma endregion
-#pragma region MEMORY FREEING FUNCTIONS
-/*------------------------ MEMORY FREEING FUNCTIONS -------------------------*/
 
 /**
- * @brief Free universe struct
- * @param u Universe
+ * @brief Hash string (FNV-1a)
+ * @param string String to be hashed
+ * @param length String length
+ * @return Hash of the string
  */
-void free_universe(struct universe* u) {
-    if (u != NULL) {
-        free(u->nodes);
-        free(u);
+unsigned int hash_string(const char* string, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)string[i];
+        hash *= 16777619u;
     }
+    return hash;
 }
 
 /**
- * @brief Free set struct
- * @param s Set
+ * @brief Build hash table for universe node lookup
+ * @param u Universe
+ * @retval true - Table was built
+ * @retval false - Allocation failed or universe contains repeated word
  */
-void free_set(struct set* s) {
-    if (s != NULL) {
-        free(s->nodes);
-        free(s);
+bool universe_build_table(struct universe* u) {
+    // Find smallest power of two big enough for given load factor
+    u->table_size = 1;
+    while (u->table_size < u->size * UNIVERSE_TABLE_FACTOR) {
+        u->table_size *= 2;
+    }
+    u->table = malloc(sizeof(int) * u->table_size);
+    if (u->table == NULL) {
+        return alloc_error();
+    }
+    // Mark all slots as free
+    for (int i = 0; i < u->table_size; i++) {
+        u->table[i] = -1;
     }
+    // Insert all nodes, collisions are resolved by linear probing
+    const unsigned int mask = u->table_size - 1;
+    for (int i = 0; i < u->size; i++) {
+        const char* name = universe_name(u, i);
+        const int length = universe_name_length(u, i);
+        unsigned int slot = hash_string(name, length) & mask;
+        while (u->table[slot] != -1) {
+            // Same word is always found in probe sequence of new word
+            if (universe_name_equals(u, u->table[slot], name, length)) {
+                return error("Repeated word inside universe!\n");
+            }
+            slot = (slot + 1) & mask;
+        }
+        u->table[slot] = i;
+    }
+    return true;
 }
 
 /**
- * @brief Free relation struct
- * @param r Relation
+ * @brief Find index of element inside universe
+ * @param u Universe
+ * @param name Element name (doesn't have to be terminated)
+ * @param length Element name length
+ * @return Index of element, -1 when element isn't in universe
  */
-void free_relation(struct relation* r) {
-    if (r != NULL) {
-        free(r->nodes);
-        free(r);
+int universe_find(struct universe* u, const char* name, int length) {
+    // Empty universe doesn't have table
+    if (u->table == NULL) {
+        return -1;
+    }
+    const unsigned int mask = u->table_size - 1;
+    unsigned int slot = hash_string(name, length) & mask;
+    // Probe until we hit free slot
+    while (u->table[slot] != -1) {
+        if (universe_name_equals(u, u->table[slot], name, length)) {
+            return u->table[slot];
+        }
+        slot = (slot + 1) & mask;
     }
+    return -1;
 }
 
+#pragma endregion
+#pragma region VALIDATIONS
+/*------------------------------- VALIDATIONS -------------------------------*/
+
 /**
- * @brief Free command struct
- * @param c Command
+ * @brief Check if universe is valid (doesn't contain reserved words)
+ *
+ * Repeated words are found when building universe table, which has to be
+ * built before calling this function. Reserved words are looked up in that
+ * table, so the check doesn't depend on universe size.
+ * @param u Universe
+ * @param defs Command definitions, command names are reserved
+ * @param def_count Number of command definitions
+ * @retval true - Universe valid
+ * @retval false - Universe invalid
  */
-void free_command(struct command* c) {
-    free(c);
+bool universe_valid(struct universe* u,
+                    const struct command_def* defs,
+                    int def_count) {
+    // Define illegal words that aren't command names
+    const char* illegal[] = {"true", "false", ""};
+    int size = sizeof(illegal) / sizeof(illegal[0]);
+
+    // Loop around all illegal words
+    for (int i = 0; i < size; i++) {
+        if (universe_find(u, illegal[i], strlen(illegal[i])) != -1) {
+            return error("Illegal word inside universe!\n");
+        }
+    }
+    // Loop around all command names
+    for (int i = 0; i < def_count; i++) {
+        if (universe_find(u, defs[i].name, strlen(defs[i].name)) != -1) {
+            return error("Illegal word inside universe!\n");
+        }
+    }
+    // Universe is valid if everything went well
+    return true;
 }
 
 /**
- * @brief Free store from memory including all children
- * @param store Pointer to store
+ * @brief Check if arguments of command are valid
+ * @param command command
+ * @param store store
+ * @param def command definition
+ * @retval true - Command arguments valid
+ * @retval false - Command arguments invalid
  */
-void free_store(struct store* store) {
-    // Free all store nodes based on their type
-    for (int i = 0; i < store->size; i++) {
-        switch (store->nodes[i].type) {
-            case SET:
-                free_set(store->nodes[i].obj);
-                break;
-            case RELATION:
-                free_relation(store->nodes[i].obj);
-                break;
-            case COMMAND:
-                free_command(store->nodes[i].obj);
-                break;
+bool command_arguments_valid(struct command* command,
+                             struct store* store,
+                             struct command_def def) {
+    // Argument points to non-existant line
+    for (int i = 0; i < command->argc; i++) {
+        if (command->args[i] < 1 || store->size < command->args[i]) {
+            return false;
         }
     }
 
-    // Free universe
-    free_universe(store->universe);
-
-    // Free empty objects
-    free_set(store->empty_set);
-    free_relation(store->empty_relation);
-
-    // Free store itself
+    // Check argument count
+    int argument_count = get_argument_count(def.input);
+    if (def.output == OUT_BOOL) {
+        if (command->argc != argument_count &&
+            command->argc != argument_count + 1) {
+            return false;
+        }
+    } else if (def.output == OUT_SELECT) {
+        if (command->argc != 2) {
+            return false;
+        }
+    } else {
+        if (command->argc != argument_count) {
+            return false;
+        }
+    }
+    // Check if argument types match input types
+    switch (def.input) {
+        case IN_SET:
+            return store->nodes[command->args[0] - 1].type != RELATION;
+        case IN_SET_UNIVERSE:
+            return store->nodes[command->args[0] - 1].type != RELATION;
+        case IN_SET_SET:
+            return store->nodes[command->args[0] - 1].type != RELATION &&
+                   store->nodes[command->args[1] - 1].type != RELATION;
+        case IN_RELATION:
+            return store->nodes[command->args[0] - 1].type != SET;
+        case IN_RELATION_UNIVERSE:
+            return store->nodes[command->args[0] - 1].type != SET;
+        case IN_RELATION_THREADS:
+            return store->nodes[command->args[0] - 1].type != SET;
+        case IN_RELATION_SET_SET:
+            return store->nodes[command->args[0] - 1].type != SET &&
+                   store->nodes[command->args[1] - 1].type != RELATION &&
+                   store->nodes[command->args[2] - 1].type != RELATION;
+        case IN_ANY:
+            return true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check if node type can follow already seen node types
+ * @param type Type of the next node (not universe)
+ * @param s_or_r_found Set or relation was already found, gets updated
+ * @param c_found Command was already found, gets updated
+ * @retval true - Node type is in correct order
+ * @retval false - Node type is in wrong order
+ */
+bool store_order_valid(enum store_node_type type,
+                       bool* s_or_r_found,
+                       bool* c_found) {
+    // Sets or relations can be only after universe or each other
+    if (type == SET || type == RELATION) {
+        if (*c_found) {
+            return false;
+        }
+        *s_or_r_found = true;
+        // Commands can only be after set or relation or command
+    } else if (type == COMMAND) {
+        if (!*s_or_r_found) {
+            return false;
+        }
+        *c_found = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Check if store is valid (correct order of node types)
+ * @param store Store
+ * @retval true - Store valid
+ * @retval false - Store invalid
+ */
+bool store_valid(struct store* store) {
+    // Ensure good order of node types
+    bool s_or_r_found = false, c_found = false;
+    for (int i = 1; i < store->size; i++) {
+        if (!store_order_valid(store->nodes[i].type, &s_or_r_found,
+                               &c_found)) {
+            return false;
+        }
+    }
+    // Ensure all types of nodes are present and the line limit
+    // wasn't exceeded
+    return s_or_r_found && c_found && (store->size <= MAX_LINES);
+}
+#pragma endregion
+#pragma region OUTPUT
+/*---------------------------------- OUTPUT ---------------------------------*/
+
+/**
+ * @brief Init output writer
+ * @param out Output writer
+ * @param fp Destination stream
+ * @param size Buffer size
+ * @retval true - Writer was initialized
+ * @retval false - Allocation failed
+ */
+bool output_init(struct output* out, FILE* fp, size_t size) {
+    out->fp = fp;
+    out->size = size;
+    out->used = 0;
+    out->data = malloc(size);
+    return out->data != NULL;
+}
+
+/**
+ * @brief Write everything waiting in buffer to destination stream
+ * @param out Output writer
+ */
+void output_flush(struct output* out) {
+    if (out->used > 0) {
+        fwrite(out->data, 1, out->used, out->fp);
+        out->used = 0;
+    }
+}
+
+/**
+ * @brief Flush and free output writer
+ * @param out Output writer
+ */
+void output_free(struct output* out) {
+    if (out->data != NULL) {
+        output_flush(out);
+        free(out->data);
+        out->data = NULL;
+    }
+}
+
+/**
+ * @brief Append bytes to output
+ * @param out Output writer
+ * @param data Bytes
+ * @param length Number of bytes
+ */
+void output_write(struct output* out, const char* data, size_t length) {
+    if (length > out->size - out->used) {
+        output_flush(out);
+        // Data that doesn't fit into buffer at all are written directly
+        if (length > out->size) {
+            fwrite(data, 1, length, out->fp);
+            return;
+        }
+    }
+    memcpy(out->data + out->used, data, length);
+    out->used += length;
+}
+
+/**
+ * @brief Append one character to output
+ * @param out Output writer
+ * @param c Character
+ */
+void output_char(struct output* out, char c) {
+    if (out->used == out->size) {
+        output_flush(out);
+    }
+    out->data[out->used++] = c;
+}
+
+/**
+ * @brief Append non-negative number to output
+ * @param out Output writer
+ * @param number Number
+ */
+void output_number(struct output* out, int number) {
+    // Digits are generated from the end
+    char digits[3 * sizeof(int)];
+    int index = sizeof(digits);
+    do {
+        digits[--index] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    output_write(out, digits + index, sizeof(digits) - index);
+}
+
+#pragma endregion
+#pragma region PRINT FUNCTIONS
+/*----------------------------- PRINT FUNCTIONS -----------------------------*/
+
+/**
+ * @brief Print bool value
+ * @param out Output writer
+ * @param b bool to be printed
+ */
+void print_bool(struct output* out, bool b) {
+    if (b) {
+        output_write(out, "true\n", 5);
+    } else {
+        output_write(out, "false\n", 6);
+    }
+}
+
+/**
+ * @brief Print number
+ * @param out Output writer
+ * @param number Number to be printed
+ */
+void print_number(struct output* out, int number) {
+    output_number(out, number);
+    output_char(out, '\n');
+}
+
+/**
+ * @brief Print name of universe element (without separators)
+ * @param out Output writer
+ * @param u Universe
+ * @param i Element index
+ */
+void print_name(struct output* out, struct universe* u, int i) {
+    output_write(out, universe_name(u, i), universe_name_length(u, i));
+}
+
+/**
+ * @brief Print set
+ * @param out Output writer
+ * @param a Set
+ * @param u Universe
+ */
+void print_set(struct output* out,
+               struct set* a,
+               struct universe* u,
+               bool is_universe) {
+    // Indicate we are printing set or universe
+    output_char(out, is_universe ? 'U' : 'S');
+    // Loop around all runs of nodes inside set, works for every layout
+    struct run_cursor c = {a, 0, 0, 0};
+    while (run_cursor_next(&c)) {
+        for (int node = c.start; node < c.end; node++) {
+            // Print each node inside set
+            output_char(out, ' ');
+            print_name(out, u, node);
+        }
+    }
+    output_char(out, '\n');
+}
+
+/**
+ * @brief Print relation
+ * @param out Output writer
+ * @param r Relation
+ * @param u Universe
+ */
+void print_relation(struct output* out,
+                    struct relation* r,
+                    struct universe* u) {
+    // Indicate we are printing relation
+    output_char(out, 'R');
+    // Loop around all nodes inside relation
+    for (int i = 0; i < r->size; i++) {
+        // Print each node inside relation
+        output_write(out, " (", 2);
+        print_name(out, u, relation_first(r, i));
+        output_char(out, ' ');
+        print_name(out, u, relation_second(r, i));
+        output_char(out, ')');
+    }
+    output_char(out, '\n');
+}
+#pragma endregion
+#pragma region SET FUNCTIONS
+/*------------------------------ SET FUNCTIONS ------------------------------*/
+
+/**
+ * @brief Check if set is empty
+ * @param a Set
+ * @retval true - Set is empty
+ * @retval false - Set is not empty
+ */
+bool set_empty(struct set* a) {
+    return a->size == 0;
+}
+
+/**
+ * @brief Find size of set
+ * @param a Set
+ * @return Set size
+ */
+int set_card(struct set* a) {
+    return a->size;
+}
+
+/**
+ * @brief Create set complement
+ * @param a Set - sorted
+ * @param u Universe
+ * @return Pointer to new set
+ */
+struct set* set_complement(struct set* a, struct universe* u) {
+    // Dense set is complemented word by word
+    if (a->layout == SET_BITSET) {
+        struct set* complement = set_create_bitset(a->words);
+        if (complement == NULL) {
+            return NULL;
+        }
+        bitset_complement(complement->bits, a->bits, u->size);
+        complement->size = u->size - a->size;
+        set_pack(complement, bitset_words(u->size));
+        return complement;
+    }
+    // Run-length set is subtracted from universe as one run
+    if (a->layout == SET_RUNS) {
+        struct set_run all = {0, u->size};
+        struct set universe = {.size = u->size,
+                               .layout = SET_RUNS,
+                               .runs = &all,
+                               .run_count = u->size > 0};
+        return set_combine_runs(&universe, a, BITSET_ANDNOT,
+                                bitset_words(u->size));
+    }
+
+    // Memory allocation for set
+    struct set* complement = calloc(1, sizeof(struct set));
+    if (complement == NULL) {
+        return NULL;
+    }
+    complement->size = 0;
+
+    int size = (u->size - a->size) * sizeof(int);
+    // If set is same as universe => complement is empty
+    if (size == 0) {
+        complement->nodes = NULL;
+        return complement;
+    }
+
+    // Memory allocation for set nodes
+    complement->nodes = malloc(size);
+    if (complement->nodes == NULL) {
+        free(complement);
+        return NULL;
+    }
+
+    // Loop around all universe nodes
+    for (int i = 0, k = 0; i < u->size; i++) {
+        // If universe node is in given set => skip adding that node into
+        // complement
+        if (k < a->size && i == a->nodes[k]) {
+            k++;
+            continue;
+        }
+        // Adds universe node into complement
+        complement->nodes[complement->size++] = i;
+    }
+    // Store complement in layout that takes the least memory
+    set_pack(complement, bitset_words(u->size));
+    return complement;
+}
+
+/**
+ * @brief Find union of two sets
+ * @param a First set - sorted
+ * @param b Second set - sorted
+ * @return Pointer to new set
+ */
+struct set* set_union(struct set* a, struct set* b) {
+    if (a->layout == SET_BITSET || b->layout == SET_BITSET) {
+        return set_combine_bitsets(a, b, BITSET_OR);
+    }
+    if (a->layout == SET_RUNS || b->layout == SET_RUNS) {
+        return set_combine_runs(a, b, BITSET_OR, 0);
+    }
+
+    // Memory allocation for set
+    struct set* s_union = calloc(1, sizeof(struct set));
+    if (s_union == NULL) {
+        return NULL;
+    }
+    s_union->size = 0;
+
+    int size = (a->size + b->size) * sizeof(int);
+    // If sets are empty => union is empty
+    if (size == 0) {
+        s_union->nodes = NULL;
+        return s_union;
+    }
+
+    // Memory allocation for set nodes
+    s_union->nodes = malloc(size);
+    if (s_union->nodes == NULL) {
+        free(s_union);
+        return NULL;
+    }
+
+    // Merge nodes of both sets
+    s_union->size = array_combine(a->nodes, a->size, b->nodes, b->size,
+                                  BITSET_OR, s_union->nodes);
+    set_pack(s_union, 0);
+
+    return s_union;
+}
+
+/**
+ * @brief Find intersect of two sets
+ * @param a Set - sorted
+ * @param b Set - sorted
+ * @return Pointer to new set
+ */
+struct set* set_intersect(struct set* a, struct set* b) {
+    // Nodes of much smaller set are looked up in other set
+    if (set_skewed(a, b)) {
+        return set_filter(a, b, true);
+    }
+    if (set_skewed(b, a)) {
+        return set_filter(b, a, true);
+    }
+    if (a->layout == SET_BITSET || b->layout == SET_BITSET) {
+        return set_combine_bitsets(a, b, BITSET_AND);
+    }
+    if (a->layout == SET_RUNS || b->layout == SET_RUNS) {
+        return set_combine_runs(a, b, BITSET_AND, 0);
+    }
+
+    // Memory allocation for set
+    struct set* intersect = calloc(1, sizeof(struct set));
+    if (intersect == NULL) {
+        return NULL;
+    }
+    intersect->size = 0;
+
+    int size = get_min(a->size, b->size) * sizeof(int);
+    // If one of the sets is empty => intersect is empty
+    if (size == 0) {
+        intersect->nodes = NULL;
+        return intersect;
+    }
+
+    // Memory allocation for set nodes
+    intersect->nodes = malloc(size);
+    if (intersect->nodes == NULL) {
+        free(intersect);
+        return NULL;
+    }
+
+    // Keep nodes of set A found inside set B
+    intersect->size = array_combine(a->nodes, a->size, b->nodes, b->size,
+                                    BITSET_AND, intersect->nodes);
+    set_pack(intersect, 0);
+    return intersect;
+}
+
+/**
+ * @brief Finds difference between two sets
+ * @param a Set - sorted
+ * @param b Set - sorted
+ * @return Pointer to new set
+ */
+struct set* set_minus(struct set* a, struct set* b) {
+    // Nodes of much smaller set are looked up in other set
+    if (set_skewed(a, b)) {
+        return set_filter(a, b, false);
+    }
+    if (a->layout == SET_BITSET || b->layout == SET_BITSET) {
+        return set_combine_bitsets(a, b, BITSET_ANDNOT);
+    }
+    if (a->layout == SET_RUNS || b->layout == SET_RUNS) {
+        return set_combine_runs(a, b, BITSET_ANDNOT, 0);
+    }
+
+    // Memory allocation for set
+    struct set* minus = calloc(1, sizeof(struct set));
+    if (minus == NULL) {
+        return NULL;
+    }
+    minus->size = 0;
+
+    int size = a->size * sizeof(int);
+    // If set A is empty => minus is empty
+    if (size == 0) {
+        minus->nodes = NULL;
+        return minus;
+    }
+
+    // Memory allocation for set nodes
+    minus->nodes = malloc(size);
+    if (minus->nodes == NULL) {
+        free(minus);
+        return NULL;
+    }
+
+    // Keep nodes of set A not found inside set B
+    minus->size = array_combine(a->nodes, a->size, b->nodes, b->size,
+                                BITSET_ANDNOT, minus->nodes);
+    set_pack(minus, 0);
+    return minus;
+}
+
+/**
+ * @brief Set subseteq function
+ * @param a Set - sorted
+ * @param b Set - sorted
+ * @retval true - Set a is subset of b or equal to b
+ * @retval false - Set a isn't subset of b or equal to b
+ */
+bool set_subseteq(struct set* a, struct set* b) {
+    // Bigger set can't be subset
+    if (a->size > b->size) {
+        return false;
+    }
+    if (a->layout == SET_BITSET && b->layout == SET_BITSET) {
+        return bitset_subseteq(a->bits, b->bits, a->words);
+    }
+    if (a->layout == SET_ARRAY &&
+        (b->layout == SET_BITSET || set_skewed(a, b))) {
+        // Look up every node from set A, until first missing one
+        for (int i = 0, from = 0; i < a->size; i++) {
+            if (!set_contains_next(b, a->nodes[i], &from)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (a->layout != SET_ARRAY || b->layout != SET_ARRAY) {
+        // Nothing may remain from set A after removing set B
+        return runs_combine(a, b, BITSET_ANDNOT, NULL, NULL) == 0;
+    }
+
+    // Index of set A
+    int k = 0;
+    // Loop around all nodes from set B or until all nodes from set A were
+    // found in set B
+    for (int i = 0; i < b->size && k < a->size; i++) {
+        // Node from set A was skipped => it isn't in set B
+        if (b->nodes[i] > a->nodes[k]) {
+            return false;
+        }
+        //  Check if node from set A is in set B => increment index of set A
+        if (b->nodes[i] == a->nodes[k]) {
+            k++;
+        }
+    }
+    // If the index of set A is the same as size of set A => is subseteq
+    return (k == a->size);
+}
+
+/**
+ * @brief Set subset function
+ * @param a Set - sorted
+ * @param b Set - sorted
+ * @retval true - Set a is subset of b
+ * @retval false - Set a isn't subset of b
+ */
+bool set_subset(struct set* a, struct set* b) {
+    // Subset is subseteq of set with different size
+    return a->size != b->size && set_subseteq(a, b);
+}
+
+/**
+ * @brief Compare two sets
+ * @param a First set - sorted
+ * @param b Second set - sorted
+ * @retval true - sets are equal
+ * @retval false - sets aren't equal
+ */
+bool set_equals(struct set* a, struct set* b) {
+    // If sets have different sizes they are different
+    if (a->size != b->size) {
+        return false;
+    }
+    if (a->layout == SET_BITSET && b->layout == SET_BITSET) {
+        return memcmp(a->bits, b->bits, sizeof(uint64_t) * a->words) == 0;
+    }
+    // Runs are always maximal, so equal sets have equal runs
+    if (a->layout == SET_RUNS && b->layout == SET_RUNS) {
+        return a->run_count == b->run_count &&
+               memcmp(a->runs, b->runs,
+                      sizeof(struct set_run) * a->run_count) == 0;
+    }
+    // Sets of same size with different layouts are compared by inclusion
+    if (a->layout != b->layout) {
+        return set_subseteq(a, b);
+    }
+
+    // Loop around all nodes
+    for (int i = 0; i < a->size; i++) {
+        // If any nodes differ sets are different
+        if (a->nodes[i] != b->nodes[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+#pragma endregion
+#pragma region BIT MATRIX
+/*-------------------------------- BIT MATRIX -------------------------------*/
+
+/**
+ * @brief Get row of bit matrix
+ * @param m Matrix
+ * @param i Row index
+ * @return Row bits
+ */
+uint64_t* bit_matrix_row(struct bit_matrix* m, int i) {
+    return m->bits + (size_t)i * m->words;
+}
+
+/**
+ * @brief Free arrays of bit matrix
+ * @param m Matrix
+ */
+void bit_matrix_destroy(struct bit_matrix* m) {
+    free(m->bits);
+    free(m->elements);
+    free(m->has_out);
+    free(m->has_in);
+}
+
+/**
+ * @brief Find elements of relation and number them in ascending order
+ * @param r Relation - indexed
+ * @param bound Highest element + 1
+ * @param index Index of each element to be filled, -1 when not used
+ * @return Number of distinct elements
+ */
+int relation_element_index(struct relation* r, int bound, int* index) {
+    for (int x = 0; x < bound; x++) {
+        index[x] = -1;
+    }
+    for (int i = 0; i < r->size; i++) {
+        index[relation_first(r, i)] = 0;
+        index[relation_second(r, i)] = 0;
+    }
+    int count = 0;
+    for (int x = 0; x < bound; x++) {
+        if (index[x] != -1) {
+            index[x] = count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Create adjacency matrix of relation
+ *
+ * Rows and columns belong only to elements used by relation, so matrix size
+ * doesn't depend on universe size.
+ * @param m Matrix to be initialized
+ * @param r Relation - indexed
+ * @param index Index of each element, -1 when not used
+ * @param bound Highest element + 1
+ * @param size Number of distinct elements
+ * @retval true - Matrix was created
+ * @retval false - Allocation failed
+ */
+bool bit_matrix_from_relation(struct bit_matrix* m,
+                              struct relation* r,
+                              const int* index,
+                              int bound,
+                              int size) {
+    m->size = size;
+    m->words = bitset_words(m->size);
+    const size_t cells = (size_t)m->size * m->words;
+    m->bits = calloc(cells > 0 ? cells : 1, sizeof(uint64_t));
+    m->elements = malloc(sizeof(int) * get_max(m->size, 1));
+    m->has_out = calloc(get_max(m->size, 1), sizeof(bool));
+    m->has_in = calloc(get_max(m->size, 1), sizeof(bool));
+    if (m->bits == NULL || m->elements == NULL || m->has_out == NULL ||
+        m->has_in == NULL) {
+        bit_matrix_destroy(m);
+        return false;
+    }
+    for (int x = 0; x < bound; x++) {
+        if (index[x] != -1) {
+            m->elements[index[x]] = x;
+        }
+    }
+    for (int i = 0; i < r->size; i++) {
+        const int a = index[relation_first(r, i)];
+        const int b = index[relation_second(r, i)];
+        bitset_set_range(bit_matrix_row(m, a), b, b + 1);
+        m->has_out[a] = true;
+        m->has_in[b] = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Check if relation is dense enough to be worked with as bit matrix
+ * of its elements, sparse relations would leave matrix mostly empty
+ * @param size Number of distinct elements
+ * @param pairs Number of relation nodes
+ * @retval true - Matrix should be used
+ * @retval false - Relation rows should be used
+ */
+bool bit_matrix_dense(int size, int pairs) {
+    const size_t cells = (size_t)size * bitset_words(size);
+    return cells <= MATRIX_MIN_WORDS ||
+           cells <= (size_t)pairs * MATRIX_DENSE_FACTOR;
+}
+
+#pragma endregion
+#pragma region RELATION FUNCTIONS
+/*--------------------------- RELATION FUNCTIONS ----------------------------*/
+
+/**
+ * @brief Build row index of sorted relation
+ * @param r Relation - sorted
+ * @retval true - Index was built
+ * @retval false - Allocation failed
+ */
+bool relation_index(struct relation* r) {
+    free(r->rows);
+    r->row_count = r->size == 0 ? 0 : relation_first(r, r->size - 1) + 1;
+    r->rows = malloc(sizeof(int) * (r->row_count + 1));
+    if (r->rows == NULL) {
+        r->row_count = 0;
+        return false;
+    }
+    // Row of first element x starts after all nodes with smaller element
+    for (int x = 0, i = 0; x <= r->row_count; x++) {
+        while (i < r->size && relation_first(r, i) < x) {
+            i++;
+        }
+        r->rows[x] = i;
+    }
+    return true;
+}
+
+/**
+ * @brief Get range of relation nodes with given first element
+ * @param r Relation - indexed
+ * @param a First element
+ * @param begin Index of first node of row
+ * @param end Index after last node of row
+ */
+void relation_row(struct relation* r, int a, int* begin, int* end) {
+    if (a < 0 || a >= r->row_count) {
+        *begin = *end = 0;
+        return;
+    }
+    *begin = r->rows[a];
+    *end = r->rows[a + 1];
+}
+
+/**
+ * @brief Check if relation contains node
+ * @param r Relation - indexed
+ * @param a First element
+ * @param b Second element
+ * @retval true - Node is inside relation
+ * @retval false - Node isn't inside relation
+ */
+bool relation_contains(struct relation* r, int a, int b) {
+    int low, high;
+    relation_row(r, a, &low, &high);
+    // Second elements of row are sorted
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (relation_second(r, middle) < b) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < r->size && relation_first(r, low) == a &&
+           relation_second(r, low) == b;
+}
+
+/**
+ * @brief Free relation created by relation functions
+ * @param r Relation
+ */
+void relation_destroy(struct relation* r) {
+    free(r->nodes);
+    free(r->keys);
+    free(r->first);
+    free(r->second);
+    free(r->rows);
+    free(r);
+}
+
+/**
+ * @brief Create sorted copy of relation with swapped elements
+ * @param r Relation
+ * @return Transposed relation in same layout (not indexed), NULL when
+ * allocation failed
+ */
+struct relation* relation_transpose(struct relation* r) {
+    // Keys are sorted as they are, other layouts are sorted as pairs
+    const bool packed = r->layout == RELATION_PACKED;
+    struct relation* t =
+        relation_create(r->size, packed ? RELATION_PACKED : RELATION_PAIRS);
+    if (t == NULL) {
+        return NULL;
+    }
+    if (packed) {
+        // Swapping halves of key swaps elements
+        for (int i = 0; i < r->size; i++) {
+            t->keys[i] = r->keys[i] << 16 | r->keys[i] >> 16;
+        }
+        t->size = r->size;
+    } else {
+        for (int i = 0; i < r->size; i++) {
+            relation_append(t, relation_second(r, i), relation_first(r, i));
+        }
+    }
+    // Swapped unique nodes are unique as well
+    relation_sort(t);
+    relation_convert(t, r->layout);
+    return t;
+}
+
+/**
+ * @brief Compare nodes of two relations
+ * @param x First relation
+ * @param i Node of first relation
+ * @param y Second relation
+ * @param k Node of second relation
+ * @return Difference between two relation nodes
+ */
+int relation_compare(struct relation* x, int i, struct relation* y, int k) {
+    if (x->layout == RELATION_PACKED && y->layout == RELATION_PACKED) {
+        return compare_keys(&x->keys[i], &y->keys[k]);
+    }
+    const struct relation_node a = relation_node_at(x, i);
+    const struct relation_node b = relation_node_at(y, k);
+    return compare_rel_nodes(&a, &b);
+}
+
+/**
+ * @brief Check if two relations of same size have same nodes
+ * @param x First relation
+ * @param y Second relation
+ * @retval true - Relations are equal
+ * @retval false - Relations aren't equal
+ */
+bool relation_nodes_equal(struct relation* x, struct relation* y) {
+    // Empty relations may have no arrays at all
+    if (x->size == 0 || x->layout != y->layout) {
+        for (int i = 0; i < x->size; i++) {
+            if (relation_compare(x, i, y, i) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    void **arrays_x[2], **arrays_y[2];
+    size_t sizes[2];
+    const int count = relation_arrays(x, x->size, arrays_x, sizes);
+    relation_arrays(y, y->size, arrays_y, sizes);
+    for (int k = 0; k < count; k++) {
+        if (memcmp(*arrays_x[k], *arrays_y[k], sizes[k]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Merge two sorted relations of same size without duplicates
+ * @param x First relation
+ * @param y Second relation
+ * @param result Relation with merged nodes appended (NULL when only size is
+ * needed)
+ * @return Number of merged nodes
+ */
+int relation_nodes_union(struct relation* x,
+                         struct relation* y,
+                         struct relation* result) {
+    int count = 0, i = 0, k = 0;
+    while (i < x->size && k < y->size) {
+        const int diff = relation_compare(x, i, y, k);
+        if (result != NULL) {
+            const struct relation_node node =
+                diff <= 0 ? relation_node_at(x, i) : relation_node_at(y, k);
+            relation_append(result, node.a, node.b);
+        }
+        count++;
+        i += diff <= 0;
+        k += diff >= 0;
+    }
+    // Copy rest of the unfinished relation
+    for (; i < x->size; i++, count++) {
+        if (result != NULL) {
+            relation_append(result, relation_first(x, i),
+                            relation_second(x, i));
+        }
+    }
+    for (; k < y->size; k++, count++) {
+        if (result != NULL) {
+            relation_append(result, relation_first(y, k),
+                            relation_second(y, k));
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Find number of elements relation works with
+ * @param r Relation - indexed
+ * @return Highest element + 1
+ */
+int relation_bound(struct relation* r) {
+    int bound = r->row_count;
+    for (int i = 0; i < r->size; i++) {
+        bound = get_max(bound, relation_second(r, i) + 1);
+    }
+    return bound;
+}
+
+/**
+ * @brief Create membership bitmap of second elements of relation
+ * @param r Relation
+ * @param words Bitmap size in words, has to cover all elements
+ * @return Bitmap, NULL when allocation failed
+ */
+uint64_t* relation_second_bits(struct relation* r, int words) {
+    uint64_t* bits = calloc(get_max(words, 1), sizeof(uint64_t));
+    if (bits != NULL) {
+        for (int i = 0; i < r->size; i++) {
+            const int b = relation_second(r, i);
+            bits[b / 64] |= (uint64_t)1 << (b % 64);
+        }
+    }
+    return bits;
+}
+
+/**
+ * @brief Index newly created relation
+ * @param r Relation - sorted
+ * @return Relation, NULL when allocation failed (relation is freed)
+ */
+struct relation* relation_finish(struct relation* r) {
+    if (!relation_index(r)) {
+        relation_destroy(r);
+        return NULL;
+    }
+    return r;
+}
+
+/**
+ * @brief Find out if relation is reflexive
+ * @param r Relation - sorted
+ * @param u Universe - sorted
+ * @retval true - Relation is reflexive
+ * @retval false - Relation isn't reflexive
+ */
+bool relation_reflexive(struct relation* r, struct universe* u) {
+    // Nodes are unique and inside universe, so every universe node is in
+    // relation with itself when there are as many diagonal nodes
+    return relation_diagonal_count(r) == u->size;
+}
+
+/**
+ * @brief Find out if relation is symmetric
+ *
+ * @param r Relation - sorted
+ * @retval true - Relation is symmetric
+ * @retval false - Relation is not symmetric
+ * @retval BOOL_ALLOC_ERROR - Allocation failed
+ */
+int relation_symmetric(struct relation* r) {
+    // Symmetric relation is same as its transposition
+    struct relation* t = relation_transpose(r);
+    if (t == NULL) {
+        return BOOL_ALLOC_ERROR;
+    }
+    const bool symmetric = relation_nodes_equal(r, t);
+    relation_destroy(t);
+    return symmetric;
+}
+
+/**
+ * @brief Find out if relation is symmetric
+ *
+ * @param r Relation - sorted
+ * @retval true - Relation is antisymmetric
+ * @retval false - Relation is not antisymmetric
+ * @retval BOOL_ALLOC_ERROR - Allocation failed
+ */
+int relation_antisymmetric(struct relation* r) {
+    struct relation* t = relation_transpose(r);
+    if (t == NULL) {
+        return BOOL_ALLOC_ERROR;
+    }
+    // Merge relation with its transposition, they may share only a == b
+    bool antisymmetric = true;
+    for (int i = 0, k = 0; antisymmetric && i < r->size && k < r->size;) {
+        const int diff = relation_compare(r, i, t, k);
+        antisymmetric =
+            diff != 0 || relation_first(r, i) == relation_second(r, i);
+        i += diff <= 0;
+        k += diff >= 0;
+    }
+    relation_destroy(t);
+    return antisymmetric;
+}
+
+/**
+ * @brief Find out if relation is transitive for nodes of given rows
+ * @param r Relation - indexed
+ * @param from First row
+ * @param to Row after last row
+ * @retval true - No node of rows breaks transitivity
+ * @retval false - Relation is not transitive
+ */
+bool relation_transitive_rows(struct relation* r, int from, int to) {
+    // Transitive relation: (aRb & bRc) => aRc
+    if (from >= to) {
+        return true;
+    }
+
+    // Loop around relation nodes of rows (aRb)
+    for (int i = r->rows[from]; i < r->rows[to]; i++) {
+        int begin, end;
+        relation_row(r, relation_second(r, i), &begin, &end);
+        // Loop around row of second element (bRc)
+        for (int j = begin; j < end; j++) {
+            // If aRc wasn't found => relation is not transitive
+            if (!relation_contains(r, relation_first(r, i),
+                                   relation_second(r, j))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find out if relation is transitive for nodes of given rows using
+ * its matrix, row of second element has to be inside row of first element
+ * @param job Transitive job with matrix
+ * @param from First row
+ * @param to Row after last row
+ * @retval true - No node of rows breaks transitivity
+ * @retval false - Relation is not transitive
+ */
+bool bit_matrix_transitive_rows(struct transitive_job* job, int from, int to) {
+    struct relation* r = job->r;
+    if (from >= to) {
+        return true;
+    }
+    for (int i = r->rows[from]; i < r->rows[to]; i++) {
+        const uint64_t* a =
+            bit_matrix_row(job->m, job->index[relation_first(r, i)]);
+        const uint64_t* b =
+            bit_matrix_row(job->m, job->index[relation_second(r, i)]);
+        if (!bitset_subseteq(b, a, job->m->words)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check rows of relation for transitivity
+ * @param job Transitive job
+ * @param from First row
+ * @param to Row after last row
+ * @retval true - No node of rows breaks transitivity
+ * @retval false - Relation is not transitive
+ */
+bool transitive_job_rows(struct transitive_job* job, int from, int to) {
+    return job->m != NULL ? bit_matrix_transitive_rows(job, from, to)
+                          : relation_transitive_rows(job->r, from, to);
+}
+
+/**
+ * @brief Check chunks of relation rows for transitivity
+ * @param arg Transitive job
+ * @return NULL
+ */
+void* transitive_worker(void* arg) {
+    struct transitive_job* job = arg;
+    int chunk;
+    while ((chunk = work_queue_take(&job->queue)) != -1) {
+        const int from = chunk * PARALLEL_CHUNK_ROWS;
+        const int to = get_min(from + PARALLEL_CHUNK_ROWS, job->r->row_count);
+        if (!transitive_job_rows(job, from, to)) {
+            work_queue_fail(&job->queue);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find out if relation is transitive
+ *
+ * Dense relations are checked on bit matrix of their elements, each row is
+ * compared with rows of its second elements word by word. Sparse relations
+ * look up nodes inside their rows.
+ * @param r Relation - sorted
+ * @param threads Number of threads
+ * @retval true - Relation is transitive
+ * @retval false - Relation is not transitive
+ * @retval BOOL_ALLOC_ERROR - Allocation failed
+ */
+int relation_transitive(struct relation* r, int threads) {
+    const int bound = relation_bound(r);
+    int* index = malloc(sizeof(int) * get_max(bound, 1));
+    if (index == NULL) {
+        return BOOL_ALLOC_ERROR;
+    }
+    const int size = relation_element_index(r, bound, index);
+    struct bit_matrix m;
+    struct transitive_job job = {.r = r, .index = index};
+    if (bit_matrix_dense(size, r->size)) {
+        if (!bit_matrix_from_relation(&m, r, index, bound, size)) {
+            free(index);
+            return BOOL_ALLOC_ERROR;
+        }
+        job.m = &m;
+    }
+
+    const int chunks = (r->row_count + PARALLEL_CHUNK_ROWS - 1) /
+                       PARALLEL_CHUNK_ROWS;
+    bool transitive;
+    // Small relations and failed setup are checked on this thread
+    if (threads <= 1 || r->size < PARALLEL_MIN_PAIRS ||
+        !work_queue_init(&job.queue, 0, chunks)) {
+        transitive = transitive_job_rows(&job, 0, r->row_count);
+    } else {
+        run_parallel(transitive_worker, &job, get_min(threads, chunks));
+        transitive = !job.queue.failed;
+        work_queue_destroy(&job.queue);
+    }
+    if (job.m != NULL) {
+        bit_matrix_destroy(&m);
+    }
+    free(index);
+    return transitive;
+}
+
+/**
+ * @brief Find out if relation is a function
+ *
+ * @param r Relation - sorted
+ * @retval true - Relation is a function
+ * @retval false - Relation is not a function
+ */
+bool relation_function(struct relation* r) {
+    // Every node has to start new row, whole blocks of nodes are compared
+    const unsigned all = (1u << SCAN_LANES) - 1;
+    int i = 1;
+    for (; i + SCAN_LANES <= r->size; i += SCAN_LANES) {
+        if (relation_row_starts(r, i) != all) {
+            return false;
+        }
+    }
+    for (; i < r->size; i++) {
+        // If current node is same as previous node => relation is not a
+        // function
+        if (relation_first(r, i) == relation_first(r, i - 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Relation domain function
+ *
+ * @param r Relation - sorted
+ * @return Pointer to a new set
+ */
+struct set* relation_domain(struct relation* r) {
+    // Memory allocation for set
+    struct set* domain = calloc(1, sizeof(struct set));
+    if (domain == NULL) {
+        return NULL;
+    }
+
+    // Memory allocation for set nodes
+    domain->nodes = malloc(sizeof(int) * get_max(r->size, 1));
+    domain->size = 0;
+
+    // Check malloc
+    if (domain->nodes == NULL) {
+        free(domain);
+        return NULL;
+    }
+
+    // Checks if relation is empty => returns empty set
+    if (r->size == 0) {
+        return domain;
+    }
+
+    // Puts the first element of the first relation node to set
+    domain->nodes[domain->size++] = relation_first(r, 0);
+    int i = 1;
+    for (; i + SCAN_LANES <= r->size; i += SCAN_LANES) {
+        // Add first element of every node starting new row
+        for (unsigned starts = relation_row_starts(r, i); starts != 0;
+             starts &= starts - 1) {
+            domain->nodes[domain->size++] =
+                relation_first(r, i + count_trailing_zeros(starts));
+        }
+    }
+    for (; i < r->size; i++) {
+        // If the last element is not the same as current element => adds
+        // element in set
+        if (relation_first(r, i) != relation_first(r, i - 1)) {
+            domain->nodes[domain->size++] = relation_first(r, i);
+        }
+    }
+    set_pack(domain, 0);
+    return domain;
+}
+
+/**
+ * @brief Relation codomain function
+ *
+ * @param r Relation - sorted
+ * @retval Set pointer - relation codomain set
+ * @retval NULL - Function failed
+ */
+struct set* relation_codomain(struct relation* r) {
+    // Memory allocation for set
+    struct set* codomain = calloc(1, sizeof(struct set));
+    if (codomain == NULL) {
+        return NULL;
+    }
+
+    // Mark every second element, then collect marks in ascending order
+    const int words = bitset_words(relation_bound(r));
+    uint64_t* bits = relation_second_bits(r, words);
+    if (bits == NULL) {
+        free(codomain);
+        return NULL;
+    }
+    for (int w = 0; w < words; w++) {
+        codomain->size += count_bits(bits[w]);
+    }
+    codomain->nodes = malloc(sizeof(int) * get_max(codomain->size, 1));
+    if (codomain->nodes == NULL) {
+        free(bits);
+        free(codomain);
+        return NULL;
+    }
+    for (int w = 0, k = 0; w < words; w++) {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+            codomain->nodes[k++] = w * 64 + count_trailing_zeros(word);
+        }
+    }
+    free(bits);
+    set_pack(codomain, 0);
+    return codomain;
+}
+
+/**
+ * @brief Find out if r only contains elements of set a and set b
+ *
+ * @param r Relation
+ * @param a Set A
+ * @param b Set B
+ * @retval true - Relation only contains elements from sets
+ * @retval false - Relation contains element(s) that aren't in sets
+ */
+bool relation_valid_sets(struct relation* r, struct set* a, struct set* b) {
+    const int bound = relation_bound(r);
+    uint64_t *tmp_a, *tmp_b;
+    const uint64_t* bits_a = set_membership(a, bound, &tmp_a);
+    const uint64_t* bits_b = set_membership(b, bound, &tmp_b);
+
+    bool valid = true;
+    for (int i = 0; valid && i < r->size; i++) {
+        // Find if set a contains first element and set b second element
+        const struct relation_node node = relation_node_at(r, i);
+        valid = bits_a != NULL && bits_b != NULL
+                    ? bitset_test(bits_a, node.a) && bitset_test(bits_b, node.b)
+                    : set_contains(a, node.a) && set_contains(b, node.b);
+    }
+    free(tmp_a);
+    free(tmp_b);
+    return valid;
+}
+
+/**
+ * @brief Find out if relation is injective
+ *
+ * @param r Relation - sorted
+ * @retval true - Relation is injective
+ * @retval false - Relation is not injective
+ */
+bool relation_injective(struct relation* r, struct set* a, struct set* b) {
+    if (!relation_valid_sets(r, a, b)) {
+        return false;
+    }
+    // First elements must be unique
+    if (!relation_function(r)) {
+        return false;
+    }
+
+    // All elements from a must be in a
+    return a->size == r->size;
+}
+
+/**
+ * @brief Find out if relation is surjective
+ *
+ * @param r Relation - sorted
+ * @return true - Relation is surjective
+ * @return false - Relation is not surjective
+ * @retval BOOL_ALLOC_ERROR - Allocation failed
+ */
+int relation_surjective(struct relation* r, struct set* a, struct set* b) {
+    if (!relation_valid_sets(r, a, b)) {
+        return false;
+    }
+    // All elements from set b have to be in relation (second position)
+    // There can be duplicates as well, so distinct elements are counted
+    const int words = bitset_words(relation_bound(r));
+    uint64_t* bits = relation_second_bits(r, words);
+    if (bits == NULL) {
+        return BOOL_ALLOC_ERROR;
+    }
+    int unique_second_elements = 0;
+    for (int w = 0; w < words; w++) {
+        unique_second_elements += count_bits(bits[w]);
+    }
+    free(bits);
+    return unique_second_elements == b->size;
+}
+
+/**
+ * @brief Find out if relation is bijective
+ *
+ * @param r Relation - sorted
+ * @retval true - Relation is bijective
+ * @return false - Relation is not bijective
+ * @retval BOOL_ALLOC_ERROR - Allocation failed
+ */
+int relation_bijective(struct relation* r, struct set* a, struct set* b) {
+    // Relation is bijective if relation is injective and surjective
+    if (!relation_injective(r, a, b)) {
+        return false;
+    }
+    return relation_surjective(r, a, b);
+}
+
+/**
+ * @brief Create reflexive relation closure
+ * @param r Relation - sorted
+ * @param u Universe - sorted
+ * @retval Relation pointer - Reflexive relation closure
+ * @retval NULL - Function failed
+ */
+struct relation* relation_closure_ref(struct relation* r, struct universe* u) {
+    // Count diagonal nodes that are already inside relation
+    const int present = relation_diagonal_count(r);
+    struct relation* result = relation_create(r->size + u->size - present,
+                                              relation_fitting_layout(u->size));
+    if (result == NULL) {
+        return NULL;
+    }
+
+    // Merge relation with diagonal, missing diagonal nodes are added in order
+    int d = 0;
+    for (int i = 0; i < r->size; i++) {
+        const struct relation_node node = relation_node_at(r, i);
+        while (d < u->size && (d < node.a || (d == node.a && d < node.b))) {
+            relation_append(result, d, d);
+            d++;
+        }
+        // Diagonal node is already inside relation
+        if (node.a == d && node.b == d) {
+            d++;
+        }
+        relation_append(result, node.a, node.b);
+    }
+    for (; d < u->size; d++) {
+        relation_append(result, d, d);
+    }
+
+    return relation_finish(result);
+}
+
+/**
+ * @brief Create symmetric relation closure
+ * @param r Relation - sorted
+ * @param u Universe - sorted
+ * @retval Relation pointer - Symmetric relation closure
+ * @retval NULL - Function failed
+ */
+struct relation* relation_closure_sym(struct relation* r) {
+    struct relation* t = relation_transpose(r);
+    if (t == NULL) {
+        return NULL;
+    }
+
+    // Count union of relation and its transposition, then merge into it
+    const int size = relation_nodes_union(r, t, NULL);
+    struct relation* result = relation_create(size, r->layout);
+    if (result == NULL) {
+        relation_destroy(t);
+        return NULL;
+    }
+    relation_nodes_union(r, t, result);
+    relation_destroy(t);
+
+    return relation_finish(result);
+}
+
+/**
+ * @brief Add closed rows of pivot block into other matrix rows
+ * @param m Matrix
+ * @param from First updated row
+ * @param to Row after last updated row
+ * @param begin First row of block
+ * @param end Row after last row of block
+ */
+void bit_matrix_add_block(struct bit_matrix* m,
+                          int from,
+                          int to,
+                          int begin,
+                          int end) {
+    for (int i = from; i < to; i++) {
+        // Row without bits never gets any
+        if ((i >= begin && i < end) || !m->has_out[i]) {
+            continue;
+        }
+        // Only set bits of block are visited, bits set on the way count
+        uint64_t* row = bit_matrix_row(m, i);
+        for (int k = bitset_next(row, m->words, begin, true); k < end;
+             k = bitset_next(row, m->words, k + 1, true)) {
+            bitset_or(row, bit_matrix_row(m, k), m->words);
+        }
+    }
+}
+
+/**
+ * @brief Add closed rows of pivot block into chunks of other rows
+ * @param arg Closure job
+ * @return NULL
+ */
+void* closure_worker(void* arg) {
+    struct closure_job* job = arg;
+    int chunk;
+    while ((chunk = work_queue_take(&job->queue)) != -1) {
+        const int from = chunk * PARALLEL_CHUNK_ROWS;
+        const int to = get_min(from + PARALLEL_CHUNK_ROWS, job->m->size);
+        bit_matrix_add_block(job->m, from, to, job->begin, job->end);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Make matrix transitive using Warshall algorithm
+ *
+ * Pivots are processed in blocks whose rows fit into cache. Rows of block
+ * are closed over block first, then they are added into all other rows.
+ * Other rows may get pivot rows with more bits than plain Warshall would
+ * use, but those bits are reachable as well, so result is the same. Other
+ * rows don't depend on each other, so they are updated on multiple threads.
+ * @param m Matrix
+ * @param threads Number of threads
+ */
+void bit_matrix_close(struct bit_matrix* m, int threads) {
+    const size_t row_size = sizeof(uint64_t) * get_max(m->words, 1);
+    const int block = get_max(CLOSURE_BLOCK_SIZE / row_size, 1);
+    const int chunks =
+        (m->size + PARALLEL_CHUNK_ROWS - 1) / PARALLEL_CHUNK_ROWS;
+    if ((size_t)m->size * m->words < PARALLEL_MIN_WORDS) {
+        threads = 1;
+    }
+
+    for (int begin = 0; begin < m->size; begin += block) {
+        const int end = get_min(begin + block, m->size);
+        // Close rows of block over pivots of block, pivot without incoming
+        // or outgoing bits doesn't connect anything
+        for (int k = begin; k < end; k++) {
+            if (!m->has_in[k] || !m->has_out[k]) {
+                continue;
+            }
+            for (int i = begin; i < end; i++) {
+                uint64_t* row = bit_matrix_row(m, i);
+                if (bitset_test(row, k)) {
+                    bitset_or(row, bit_matrix_row(m, k), m->words);
+                }
+            }
+        }
+        // Add rows of block into all other rows
+        struct closure_job job = {.m = m, .begin = begin, .end = end};
+        if (threads <= 1 || !work_queue_init(&job.queue, 0, chunks)) {
+            bit_matrix_add_block(m, 0, m->size, begin, end);
+            continue;
+        }
+        run_parallel(closure_worker, &job, get_min(threads, chunks));
+        work_queue_destroy(&job.queue);
+    }
+}
+
+/**
+ * @brief Create relation from adjacency matrix
+ * @param m Matrix
+ * @return Sorted and indexed relation, NULL when allocation failed
+ */
+struct relation* bit_matrix_to_relation(struct bit_matrix* m) {
+    // Count nodes first, so relation is allocated only once
+    int size = 0;
+    for (size_t w = 0; w < (size_t)m->size * m->words; w++) {
+        size += count_bits(m->bits[w]);
+    }
+    const int bound = m->size == 0 ? 0 : m->elements[m->size - 1] + 1;
+    struct relation* result =
+        relation_create(size, relation_fitting_layout(bound));
+    if (result == NULL) {
+        return NULL;
+    }
+    // Rows and bits inside rows are visited in ascending order of elements
+    for (int i = 0; i < m->size; i++) {
+        const uint64_t* row = bit_matrix_row(m, i);
+        for (int w = 0; w < m->words; w++) {
+            for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+                const int k = w * 64 + count_trailing_zeros(bits);
+                relation_append(result, m->elements[i], m->elements[k]);
+            }
+        }
+    }
+    return relation_finish(result);
+}
+
+/**
+ * @brief Find everything reachable from first elements of given rows
+ * @param r Relation - indexed
+ * @param from First row
+ * @param to Row after last row
+ * @param stack Search stack, there has to be space for 2 * r->size elements
+ * @param visited First element of last search that reached each element,
+ * shared by searches of one thread
+ * @param nodes Closure nodes of rows to be allocated, sorted
+ * @param size Number of closure nodes
+ * @retval true - Rows were searched
+ * @retval false - Allocation failed
+ */
+bool relation_search_rows(struct relation* r,
+                          int from,
+                          int to,
+                          int* stack,
+                          int* visited,
+                          struct relation_node** nodes,
+                          int* size) {
+    int allocated = INITIAL_RELATION_ALLOC;
+    *nodes = malloc(sizeof(struct relation_node) * allocated);
+    *size = 0;
+    if (*nodes == NULL) {
+        return false;
+    }
+
+    // Search everything reachable from each first element
+    for (int a = from; a < to; a++) {
+        const int row_start = *size;
+        int depth = 0, begin, end;
+        relation_row(r, a, &begin, &end);
+        for (int i = begin; i < end; i++) {
+            stack[depth++] = relation_second(r, i);
+        }
+        while (depth > 0) {
+            const int b = stack[--depth];
+            if (visited[b] == a) {
+                continue;
+            }
+            visited[b] = a;
+            // Add aRb to result
+            if (!smart_realloc((void**)nodes, *size + 1, &allocated,
+                               sizeof(struct relation_node))) {
+                return false;
+            }
+            (*nodes)[(*size)++] = (struct relation_node){.a = a, .b = b};
+            // Continue with unvisited nodes of its row
+            relation_row(r, b, &begin, &end);
+            for (int i = begin; i < end; i++) {
+                if (visited[relation_second(r, i)] != a) {
+                    stack[depth++] = relation_second(r, i);
+                }
+            }
+        }
+        // Elements are reached in any order
+        qsort(*nodes + row_start, *size - row_start,
+              sizeof(struct relation_node), compare_rel_nodes);
+    }
+    return true;
+}
+
+/**
+ * @brief Search chunks of relation rows
+ * @param arg Closure search job
+ * @return NULL
+ */
+void* closure_search_worker(void* arg) {
+    struct closure_search_job* job = arg;
+    // Every row is expanded at most once per search, first row maybe twice
+    int* stack = malloc(sizeof(int) * get_max(2 * job->r->size, 1));
+    int* visited = malloc(sizeof(int) * get_max(job->bound, 1));
+    if (stack == NULL || visited == NULL) {
+        work_queue_fail(&job->queue);
+        free(stack);
+        free(visited);
+        return NULL;
+    }
+    for (int i = 0; i < job->bound; i++) {
+        visited[i] = -1;
+    }
+    int chunk;
+    while ((chunk = work_queue_take(&job->queue)) != -1) {
+        const int from = chunk * PARALLEL_CHUNK_ROWS;
+        const int to = get_min(from + PARALLEL_CHUNK_ROWS, job->r->row_count);
+        if (!relation_search_rows(job->r, from, to, stack, visited,
+                                  &job->nodes[chunk], &job->sizes[chunk])) {
+            work_queue_fail(&job->queue);
+        }
+    }
+    free(stack);
+    free(visited);
+    return NULL;
+}
+
+/**
+ * @brief Create transitive relation closure by searching relation rows
+ *
+ * Chunks of rows are searched on multiple threads, their nodes are joined
+ * in order of rows, so result doesn't depend on number of threads.
+ * @param r Relation - indexed
+ * @param bound Highest element + 1
+ * @param threads Number of threads
+ * @retval Relation pointer - Transitive relation closure
+ * @retval NULL - Function failed
+ */
+struct relation* relation_closure_search(struct relation* r,
+                                         int bound,
+                                         int threads) {
+    const int chunks =
+        (r->row_count + PARALLEL_CHUNK_ROWS - 1) / PARALLEL_CHUNK_ROWS;
+    struct closure_search_job job = {.r = r, .bound = bound};
+    job.nodes = calloc(get_max(chunks, 1), sizeof(struct relation_node*));
+    job.sizes = calloc(get_max(chunks, 1), sizeof(int));
+    if (job.nodes == NULL || job.sizes == NULL ||
+        !work_queue_init(&job.queue, 0, chunks)) {
+        free(job.nodes);
+        free(job.sizes);
+        return NULL;
+    }
+    if (r->size < PARALLEL_MIN_PAIRS) {
+        threads = 1;
+    }
+    run_parallel(closure_search_worker, &job, get_min(threads, chunks));
+
+    // Count nodes first, so relation is allocated only once
+    int size = 0;
+    for (int c = 0; c < chunks; c++) {
+        size += job.sizes[c];
+    }
+    struct relation* result =
+        job.queue.failed
+            ? NULL
+            : relation_create(size, relation_fitting_layout(bound));
+    for (int c = 0; c < chunks; c++) {
+        for (int i = 0; result != NULL && i < job.sizes[c]; i++) {
+            relation_append(result, job.nodes[c][i].a, job.nodes[c][i].b);
+        }
+        free(job.nodes[c]);
+    }
+    free(job.nodes);
+    free(job.sizes);
+    work_queue_destroy(&job.queue);
+    return result != NULL ? relation_finish(result) : NULL;
+}
+
+/**
+ * @brief Create transitive relation closure
+ *
+ * Dense relations are closed on bit matrix of their elements, sparse ones by
+ * searching their rows, because matrix would be mostly empty.
+ * @param r Relation - sorted
+ * @param threads Number of threads
+ * @retval Relation pointer - Transitive relation closure
+ * @retval NULL - Function failed
+ */
+struct relation* relation_closure_trans(struct relation* r, int threads) {
+    const int bound = relation_bound(r);
+    int* index = malloc(sizeof(int) * get_max(bound, 1));
+    if (index == NULL) {
+        return NULL;
+    }
+    const int size = relation_element_index(r, bound, index);
+    if (!bit_matrix_dense(size, r->size)) {
+        free(index);
+        return relation_closure_search(r, bound, threads);
+    }
+
+    struct bit_matrix m;
+    const bool ok = bit_matrix_from_relation(&m, r, index, bound, size);
+    free(index);
+    if (!ok) {
+        return NULL;
+    }
+    bit_matrix_close(&m, threads);
+    struct relation* result = bit_matrix_to_relation(&m);
+    bit_matrix_destroy(&m);
+    return result;
+}
+
+#pragma endregion
+#pragma region SPECIAL COMMANDS
+/*---------------------------- SPECIAL COMMANDS -----------------------------*/
+
+/**
+ * @brief Select random item from set
+ * @param s Set
+ * @param u Universe
+ */
+void select_random_from_set(struct set* s, struct select_result* result) {
+    // Check if set is empty
+    if (set_empty(s)) {
+        result->empty = true;
+        return;
+    }
+    // Get random index to set
+    int rand_index = rand() % s->size;
+
+    result->item = calloc(1, sizeof(struct set));
+    if (result->item == NULL) {
+        result->error = true;
+        return;
+    }
+    result->item->size = 1;
+    result->item->nodes = malloc(sizeof(int));
+    if (result->item->nodes == NULL) {
+        free(result->item);
+        result->error = true;
+        return;
+    }
+
+    result->item->nodes[0] = set_node_at(s, rand_index);
+}
+
+/**
+ * @brief Select random item from relation
+ * @param r Relation
+ * @param u Universe
+ */
+void select_random_from_relation(struct relation* r,
+                                 struct select_result* result) {
+    // Check if relation is empty
+    if (r->size == 0) {
+        result->empty = true;
+        return;
+    }
+    // Get random index to relation
+    int rand_index = rand() % r->size;
+    // Find a, b in relation
+    struct relation_node node = relation_node_at(r, rand_index);
+
+    result->item = calloc(1, sizeof(struct set));
+    if (result->item == NULL) {
+        result->error = true;
+        return;
+    }
+    result->item->size = 1;
+    result->item->nodes = malloc(sizeof(int));
+    if (result->item->nodes == NULL) {
+        free(result->item);
+        result->error = true;
+        return;
+    }
+
+    result->item->nodes[0] = rand() % 2 == 0 ? node.a : node.b;
+}
+
+/**
+ * @brief Select command
+ * @param node Node from universe (set or relation)
+ * @param u Universe
+ * @return Select result
+ */
+struct select_result* select_command(struct store_node* node) {
+    struct select_result* result = malloc(sizeof(struct select_result));
+    if (result == NULL) {
+        return NULL;
+    }
+    result->empty = false;
+    result->error = false;
+    result->item = NULL;
+
+    if (node->type == SET) {
+        select_random_from_set(node->obj, result);
+    } else if (node->type == RELATION) {
+        select_random_from_relation(node->obj, result);
+    } else {
+        result->empty = true;
+    }
+
+    return result;
+}
+#pragma endregion
+#pragma region MEMORY FREEING FUNCTIONS
+/*------------------------ MEMORY FREEING FUNCTIONS -------------------------*/
+
+/**
+ * @brief Free universe struct
+ * @param u Universe
+ */
+void free_universe(struct universe* u) {
+    if (u != NULL) {
+        free(u->names);
+        free(u->offsets);
+        free(u->table);
+        free(u);
+    }
+}
+
+/**
+ * @brief Free set struct
+ * @param s Set
+ */
+void free_set(struct set* s) {
+    if (s != NULL) {
+        free(s->nodes);
+        free(s->bits);
+        free(s->runs);
+        free(s);
+    }
+}
+
+/**
+ * @brief Free relation struct
+ * @param r Relation
+ */
+void free_relation(struct relation* r) {
+    if (r != NULL) {
+        free(r->nodes);
+        free(r->keys);
+        free(r->first);
+        free(r->second);
+        free(r->rows);
+        free(r);
+    }
+}
+
+/**
+ * @brief Free command struct
+ * @param c Command
+ */
+void free_command(struct command* c) {
+    free(c);
+}
+
+/**
+ * @brief Free store node object unless it is owned by store arena
+ * @param node Store node
+ */
+void free_store_node(struct store_node* node) {
+    if (node->in_arena) {
+        return;
+    }
+    switch (node->type) {
+        case SET:
+            free_set(node->obj);
+            break;
+        case RELATION:
+            free_relation(node->obj);
+            break;
+        case COMMAND:
+            free_command(node->obj);
+            break;
+    }
+}
+
+/**
+ * @brief Move set into single arena allocation of exact size
+ * @param a Arena
+ * @param s Set, freed when moved
+ * @return Set inside arena, NULL when allocation failed
+ */
+struct set* arena_adopt_set(struct arena* a, struct set* s) {
+    const size_t nodes = s->nodes == NULL ? 0 : sizeof(int) * s->size;
+    const size_t bits = s->bits == NULL ? 0 : sizeof(uint64_t) * s->words;
+    const size_t runs =
+        s->runs == NULL ? 0 : sizeof(struct set_run) * s->run_count;
+    char* pos = arena_alloc(a, arena_size(sizeof(struct set)) +
+                                   arena_size(nodes) + arena_size(bits) + runs);
+    if (pos == NULL) {
+        return NULL;
+    }
+
+    struct set* copy = arena_place(&pos, s, sizeof(struct set));
+    copy->nodes = arena_place(&pos, s->nodes, nodes);
+    copy->bits = arena_place(&pos, s->bits, bits);
+    copy->runs = arena_place(&pos, s->runs, runs);
+    free_set(s);
+    return copy;
+}
+
+/**
+ * @brief Move relation into single arena allocation of exact size
+ * @param a Arena
+ * @param r Relation, freed when moved
+ * @return Relation inside arena, NULL when allocation failed
+ */
+struct relation* arena_adopt_relation(struct arena* a, struct relation* r) {
+    void** arrays[2];
+    size_t sizes[2];
+    const int count = relation_arrays(r, r->size, arrays, sizes);
+    const size_t rows = r->rows == NULL ? 0 : sizeof(int) * (r->row_count + 1);
+    size_t size = arena_size(sizeof(struct relation)) + rows;
+    for (int k = 0; k < count; k++) {
+        size += arena_size(sizes[k]);
+    }
+    char* pos = arena_alloc(a, size);
+    if (pos == NULL) {
+        return NULL;
+    }
+
+    // Copy still points to original arrays, they are replaced one by one
+    struct relation* copy = arena_place(&pos, r, sizeof(struct relation));
+    relation_arrays(copy, copy->size, arrays, sizes);
+    for (int k = 0; k < count; k++) {
+        *arrays[k] = arena_place(&pos, *arrays[k], sizes[k]);
+    }
+    copy->rows = arena_place(&pos, r->rows, rows);
+    free_relation(r);
+    return copy;
+}
+
+/**
+ * @brief Move store node object into store arena, so it is freed together
+ * with whole store and doesn't keep unused capacity
+ * @param store Store
+ * @param node Store node, it is left untouched when allocation fails
+ * @retval true - Node is owned by arena (or by itself while streaming)
+ * @retval false - Allocation failed
+ */
+bool store_adopt(struct store* store, struct store_node* node) {
+    if (node->in_arena || node->obj == NULL) {
+        return true;
+    }
+    // Sets and relations moved out while streaming are freed one by one
+    if (store->spill.file != NULL && node->type != COMMAND) {
+        return true;
+    }
+
+    void* copy = NULL;
+    switch (node->type) {
+        case SET:
+            copy = arena_adopt_set(&store->arena, node->obj);
+            break;
+        case RELATION:
+            copy = arena_adopt_relation(&store->arena, node->obj);
+            break;
+        case COMMAND: {
+            char* pos = arena_alloc(&store->arena, sizeof(struct command));
+            if (pos != NULL) {
+                copy = arena_place(&pos, node->obj, sizeof(struct command));
+                free_command(node->obj);
+            }
+            break;
+        }
+    }
+    if (copy == NULL) {
+        return false;
+    }
+
+    node->obj = copy;
+    node->in_arena = true;
+    return true;
+}
+
+/**
+ * @brief Free store from memory including all children
+ * @param store Pointer to store
+ */
+void free_store(struct store* store) {
+    // Free store nodes which weren't moved into arena, then arena at once
+    for (int i = 0; i < store->size; i++) {
+        free_store_node(&store->nodes[i]);
+    }
+    arena_release(&store->arena);
+
+    // Free cache table, its objects were in arena
+    free(store->memo.entries);
+
+    // Free temporary file of lines moved out while streaming
+    if (store->spill.file != NULL) {
+        fclose(store->spill.file);
+    }
+    free(store->spill.offsets);
+
+    // Free universe
+    free_universe(store->universe);
+
+    // Free empty objects
+    free_set(store->empty_set);
+    free_relation(store->empty_relation);
+
+    // Write out remaining output
+    output_free(&store->output);
+
+    // Free store itself
     free(store->nodes);
 }
 #pragma endregion
-#pragma region COMMAND_DEFS
-const struct command_def COMMAND_DEFS[] = {
-    // Function name, function pointer, input, output
-    {"empty", set_empty, IN_SET, OUT_BOOL},
-    {"card", set_card, IN_SET, OUT_VOID},
-    {"complement", set_complement, IN_SET_UNIVERSE, OUT_SET},
-    {"union", set_union, IN_SET_SET, OUT_SET},
-    {"intersect", set_intersect, IN_SET_SET, OUT_SET},
-    {"minus", set_minus, IN_SET_SET, OUT_SET},
-    {"subseteq", set_subseteq, IN_SET_SET, OUT_BOOL},
-    {"subset", set_subset, IN_SET_SET, OUT_BOOL},
-    {"equals", set_equals, IN_SET_SET, OUT_BOOL},
-    {"reflexive", relation_reflexive, IN_RELATION_UNIVERSE, OUT_BOOL},
-    {"symmetric", relation_symmetric, IN_RELATION, OUT_BOOL},
-    {"antisymmetric", relation_antisymmetric, IN_RELATION, OUT_BOOL},
-    {"transitive", relation_transitive, IN_RELATION, OUT_BOOL},
-    {"function", relation_function, IN_RELATION, OUT_BOOL},
-    {"domain", relation_domain, IN_RELATION, OUT_SET},
-    {"codomain", relation_codomain, IN_RELATION, OUT_SET},
-    {"injective", relation_injective, IN_RELATION_SET_SET, OUT_BOOL},
-    {"surjective", relation_surjective, IN_RELATION_SET_SET, OUT_BOOL},
-    {"bijective", relation_bijective, IN_RELATION_SET_SET, OUT_BOOL},
-    {"closure_ref", relation_closure_ref, IN_RELATION_UNIVERSE, OUT_RELATION},
-    {"closure_sym", relation_closure_sym, IN_RELATION, OUT_RELATION},
-    {"closure_trans", relation_closure_trans, IN_RELATION, OUT_RELATION},
-    {"select", select_command, IN_ANY, OUT_SELECT}};
+#pragma region COMMAND_DEFS
+const struct command_def COMMAND_DEFS[] = {
+    // Function name, function pointer, input, output
+    {"empty", set_empty, IN_SET, OUT_BOOL},
+    {"card", set_card, IN_SET, OUT_NUMBER},
+    {"complement", set_complement, IN_SET_UNIVERSE, OUT_SET},
+    {"union", set_union, IN_SET_SET, OUT_SET},
+    {"intersect", set_intersect, IN_SET_SET, OUT_SET},
+    {"minus", set_minus, IN_SET_SET, OUT_SET},
+    {"subseteq", set_subseteq, IN_SET_SET, OUT_BOOL},
+    {"subset", set_subset, IN_SET_SET, OUT_BOOL},
+    {"equals", set_equals, IN_SET_SET, OUT_BOOL},
+    {"reflexive", relation_reflexive, IN_RELATION_UNIVERSE, OUT_BOOL},
+    {"symmetric", relation_symmetric, IN_RELATION, OUT_BOOL},
+    {"antisymmetric", relation_antisymmetric, IN_RELATION, OUT_BOOL},
+    {"transitive", relation_transitive, IN_RELATION_THREADS, OUT_BOOL},
+    {"function", relation_function, IN_RELATION, OUT_BOOL},
+    {"domain", relation_domain, IN_RELATION, OUT_SET},
+    {"codomain", relation_codomain, IN_RELATION, OUT_SET},
+    {"injective", relation_injective, IN_RELATION_SET_SET, OUT_BOOL},
+    {"surjective", relation_surjective, IN_RELATION_SET_SET, OUT_BOOL},
+    {"bijective", relation_bijective, IN_RELATION_SET_SET, OUT_BOOL},
+    {"closure_ref", relation_closure_ref, IN_RELATION_UNIVERSE, OUT_RELATION},
+    {"closure_sym", relation_closure_sym, IN_RELATION, OUT_RELATION},
+    {"closure_trans", relation_closure_trans, IN_RELATION_THREADS,
+     OUT_RELATION},
+    {"select", select_command, IN_ANY, OUT_SELECT}};
+#pragma endregion
+#pragma region RESULT CACHE
+/*------------------------------- RESULT CACHE ------------------------------*/
+
+/**
+ * @brief Build cache key of command from its function arguments, jump target
+ * isn't part of key
+ * @param s Store
+ * @param c Command
+ * @param input Function input
+ * @param key Key to be filled
+ */
+void memo_key(struct store* s,
+              struct command* c,
+              enum function_input input,
+              struct memo_entry* key) {
+    const int count = get_argument_count(input);
+    key->type = c->type;
+    for (int k = 0; k < MAX_COMMAND_ARGUMENTS; k++) {
+        const bool used = k < count;
+        key->args[k] = used ? c->args[k] : 0;
+        key->versions[k] = used ? s->nodes[c->args[k] - 1].version : 0;
+    }
+    key->result = NULL;
+}
+
+/**
+ * @brief Hash cache key
+ * @param key Key
+ * @return Hash of type, argument lines and their versions
+ */
+unsigned int memo_hash(const struct memo_entry* key) {
+    int data[1 + 2 * MAX_COMMAND_ARGUMENTS];
+    data[0] = key->type;
+    memcpy(data + 1, key->args, sizeof(key->args));
+    memcpy(data + 1 + MAX_COMMAND_ARGUMENTS, key->versions,
+           sizeof(key->versions));
+    return hash_string((const char*)data, sizeof(data));
+}
+
+/**
+ * @brief Find slot of key in cache table
+ * @param m Cache
+ * @param key Key
+ * @return Slot holding key, or free slot where key belongs
+ */
+struct memo_entry* memo_slot(struct memo* m, const struct memo_entry* key) {
+    const unsigned int mask = m->size - 1;
+    unsigned int slot = memo_hash(key) & mask;
+    // Table is never full, so probing ends at free slot
+    while (m->entries[slot].type != -1 &&
+           (m->entries[slot].type != key->type ||
+            memcmp(m->entries[slot].args, key->args, sizeof(key->args)) != 0 ||
+            memcmp(m->entries[slot].versions, key->versions,
+                   sizeof(key->versions)) != 0)) {
+        slot = (slot + 1) & mask;
+    }
+    return &m->entries[slot];
+}
+
+/**
+ * @brief Find cached result of command
+ * @param m Cache
+ * @param key Key
+ * @return Cache entry, NULL when result isn't cached
+ */
+struct memo_entry* memo_find(struct memo* m, const struct memo_entry* key) {
+    if (m->count == 0) {
+        return NULL;
+    }
+    struct memo_entry* entry = memo_slot(m, key);
+    return entry->type == -1 ? NULL : entry;
+}
+
+/**
+ * @brief Resize cache table, all entries are inserted again
+ * @param m Cache
+ * @param size New table size (power of two)
+ * @return true When table was resized
+ * @return false When malloc failed
+ */
+bool memo_resize(struct memo* m, int size) {
+    struct memo_entry* entries = malloc(sizeof(struct memo_entry) * size);
+    if (entries == NULL) {
+        return false;
+    }
+    for (int k = 0; k < size; k++) {
+        entries[k].type = -1;
+    }
+    struct memo old = *m;
+    m->entries = entries;
+    m->size = size;
+    for (int k = 0; k < old.size; k++) {
+        if (old.entries[k].type != -1) {
+            *memo_slot(m, &old.entries[k]) = old.entries[k];
+        }
+    }
+    free(old.entries);
+    return true;
+}
+
+/**
+ * @brief Insert command result into cache, entries of replaced argument nodes
+ * are never matched again because their versions changed
+ * @param m Cache
+ * @param key Key
+ * @param result Result object (owned by store arena) or value
+ * @return true When result was inserted
+ * @return false When malloc failed or cache is disabled (result just isn't
+ * cached)
+ */
+bool memo_insert(struct memo* m, const struct memo_entry* key, void* result) {
+    if (m->disabled) {
+        return false;
+    }
+    // Keep table at most half full
+    if ((m->count + 1) * 2 > m->size &&
+        !memo_resize(m, m->size == 0 ? INITIAL_MEMO_ALLOC : m->size * 2)) {
+        return false;
+    }
+    struct memo_entry* entry = memo_slot(m, key);
+    if (entry->type == -1) {
+        m->count++;
+    }
+    *entry = *key;
+    entry->result = result;
+    return true;
+}
+
+/**
+ * @brief Print cache counters to standard error
+ * @param m Cache
+ */
+void print_memo_stats(struct memo* m) {
+    fprintf(stderr, "Cache hits: %ld, misses: %ld\n", m->hits, m->misses);
+}
+#pragma endregion
+#pragma region BINARY STORE
+/*------------------------------- BINARY STORE ------------------------------*/
+
+/**
+ * @brief Write block of data into file
+ * @param fp File pointer
+ * @param data Data
+ * @param size Data size in bytes
+ * @retval true - Data was written
+ * @retval false - Write failed
+ */
+bool write_data(FILE* fp, const void* data, size_t size) {
+    return size == 0 || fwrite(data, size, 1, fp) == 1;
+}
+
+/**
+ * @brief Write store node header and its data into binary file
+ * @param fp File pointer
+ * @param n Store node
+ * @retval true - Node was written
+ * @retval false - Write failed
+ */
+bool write_node(FILE* fp, struct store_node* n) {
+    struct binary_node node = {n->type, 0, SET_ARRAY, 0};
+    const void* data = n->obj;
+    size_t size = sizeof(struct command);
+    if (node.type == SET) {
+        struct set* s = n->obj;
+        node.size = s->size;
+        node.layout = s->layout;
+        if (s->layout == SET_BITSET) {
+            node.count = s->words;
+            data = s->bits;
+            size = sizeof(uint64_t) * s->words;
+        } else if (s->layout == SET_RUNS) {
+            node.count = s->run_count;
+            data = s->runs;
+            size = sizeof(struct set_run) * s->run_count;
+        } else {
+            data = s->nodes;
+            size = sizeof(int) * s->size;
+        }
+    } else if (node.type == RELATION) {
+        // Relation nodes can be split into more arrays
+        struct relation* r = n->obj;
+        node.size = r->size;
+        node.layout = r->layout;
+        void** arrays[2];
+        size_t sizes[2];
+        const int count = relation_arrays(r, r->size, arrays, sizes);
+        bool ok = write_data(fp, &node, sizeof(node));
+        for (int k = 0; ok && k < count; k++) {
+            ok = write_data(fp, *arrays[k], sizes[k]);
+        }
+        return ok;
+    }
+    return write_data(fp, &node, sizeof(node)) && write_data(fp, data, size);
+}
+
+/**
+ * @brief Write parsed and validated store into binary file
+ *
+ * File is a snapshot of in-memory structures, so it can be only loaded by
+ * the same build of the program.
+ * @param store Store
+ * @param filename Output file name
+ * @retval true - Store was written
+ * @retval false - Store couldn't be written
+ */
+bool write_store(struct store* store, char* filename) {
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return error("Failed to open file!\n");
+    }
+
+    struct universe* u = store->universe;
+    struct binary_header header = {BINARY_MAGIC, BINARY_VERSION, u->size,
+                                   u->size == 0 ? 0 : u->offsets[u->size],
+                                   store->size};
+    bool ok = write_data(fp, &header, sizeof(header));
+    if (u->size != 0) {
+        ok = ok && write_data(fp, u->offsets, sizeof(int) * (u->size + 1)) &&
+             write_data(fp, u->names, header.names_size);
+    }
+
+    // First node is universe set, it is generated again when loading
+    for (int i = 1; ok && i < store->size; i++) {
+        ok = write_node(fp, &store->nodes[i]);
+    }
+
+    if (fclose(fp) == EOF || !ok) {
+        return error("Failed to write file!\n");
+    }
+    return true;
+}
+
+/**
+ * @brief Check if input is compiled binary store
+ * @param input Input
+ * @retval true - Input starts with binary store header
+ * @retval false - Input is text
+ */
+bool input_is_binary(struct input* input) {
+    return input->size >= sizeof(struct binary_header) &&
+           memcmp(input->data, BINARY_MAGIC, BINARY_MAGIC_SIZE) == 0;
+}
+
+/**
+ * @brief Copy block of data from binary input
+ * @param pos Current position inside input, gets moved after the block
+ * @param end End of input
+ * @param dest Destination (can be NULL when size is 0)
+ * @param size Block size in bytes
+ * @retval true - Block was copied
+ * @retval false - Input is too short
+ */
+bool read_data(const char** pos, const char* end, void* dest, size_t size) {
+    if ((size_t)(end - *pos) < size) {
+        return false;
+    }
+    if (size != 0) {
+        memcpy(dest, *pos, size);
+    }
+    *pos += size;
+    return true;
+}
+
+/**
+ * @brief Allocate array and fill it from binary input
+ * @param pos Current position inside input, gets moved after the array
+ * @param end End of input
+ * @param array Pointer to array, stays NULL for empty arrays
+ * @param size Array size in bytes
+ * @retval true - Array was loaded
+ * @retval false - Allocation failed or input is too short
+ */
+bool read_array(const char** pos, const char* end, void** array, size_t size) {
+    *array = NULL;
+    if (size == 0) {
+        return true;
+    }
+    if ((size_t)(end - *pos) < size) {
+        return false;
+    }
+    *array = malloc(size);
+    return *array != NULL && read_data(pos, end, *array, size);
+}
+
+/**
+ * @brief Load set content from compiled binary store
+ * @param pos Current position, moved after set
+ * @param end End of input
+ * @param node Node header
+ * @param s Set to be filled
+ * @param universe_size Universe size
+ * @retval true - Set was loaded
+ * @retval false - Data is invalid or allocation failed
+ */
+bool load_set(const char** pos,
+              const char* end,
+              struct binary_node* node,
+              struct set* s,
+              int universe_size) {
+    s->size = node->size;
+    if (node->layout == SET_ARRAY) {
+        if (!read_array(pos, end, (void**)&s->nodes, sizeof(int) * s->size)) {
+            return false;
+        }
+        // Nodes have to be sorted, unique and inside universe
+        for (int i = 0; i < s->size; i++) {
+            if (s->nodes[i] < (i == 0 ? 0 : s->nodes[i - 1] + 1) ||
+                s->nodes[i] >= universe_size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (node->layout == SET_BITSET) {
+        // Bitset has to cover exactly the universe
+        const int words = bitset_words(universe_size);
+        if (node->count != words || words == 0 ||
+            !read_array(pos, end, (void**)&s->bits,
+                        sizeof(uint64_t) * words)) {
+            return false;
+        }
+        s->layout = SET_BITSET;
+        s->words = words;
+        // Size is counted from bits, header isn't trusted
+        s->size = 0;
+        for (int w = 0; w < words; w++) {
+            s->size += count_bits(s->bits[w]);
+        }
+        return true;
+    }
+
+    if (node->layout != SET_RUNS || node->count <= 0 ||
+        !read_array(pos, end, (void**)&s->runs,
+                    sizeof(struct set_run) * node->count)) {
+        return false;
+    }
+    s->layout = SET_RUNS;
+    s->run_count = node->count;
+    // Runs have to be sorted, maximal and inside universe
+    s->size = 0;
+    for (int i = 0; i < s->run_count; i++) {
+        const struct set_run run = s->runs[i];
+        if (run.start < (i == 0 ? 0 : s->runs[i - 1].end + 1) ||
+            run.end <= run.start || run.end > universe_size) {
+            return false;
+        }
+        s->size += run.end - run.start;
+    }
+    return true;
+}
+
+/**
+ * @brief Check that loaded universe names lie inside names block
+ * @param u Universe
+ * @param names_size Size of names block
+ * @retval true - Offsets start at 0, never decrease and end at names size
+ * @retval false - Offsets are invalid
+ */
+bool universe_offsets_valid(struct universe* u, int names_size) {
+    for (int i = 0; i < u->size; i++) {
+        if (u->offsets[i + 1] < u->offsets[i]) {
+            return false;
+        }
+    }
+    return u->offsets[0] == 0 && u->offsets[u->size] == names_size;
+}
+
+/**
+ * @brief Check that loaded relation is sorted and inside universe
+ * @param r Relation
+ * @param universe_size Universe size
+ * @retval true - Relation is valid
+ * @retval false - Relation is invalid
+ */
+bool relation_loaded_valid(struct relation* r, int universe_size) {
+    for (int i = 0; i < r->size; i++) {
+        const struct relation_node node = relation_node_at(r, i);
+        if (node.a < 0 || node.a >= universe_size || node.b < 0 ||
+            node.b >= universe_size ||
+            (i > 0 && relation_compare(r, i - 1, r, i) >= 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Load relation content from compiled binary store
+ * @param pos Current position, moved after relation
+ * @param end End of input
+ * @param node Node header
+ * @param r Relation to be filled
+ * @param universe_size Universe size
+ * @retval true - Relation was loaded
+ * @retval false - Data is invalid or allocation failed
+ */
+bool load_relation(const char** pos,
+                   const char* end,
+                   struct binary_node* node,
+                   struct relation* r,
+                   int universe_size) {
+    r->size = node->size;
+    if (node->layout != RELATION_PAIRS && node->layout != RELATION_PACKED &&
+        node->layout != RELATION_COLUMNS) {
+        return false;
+    }
+    r->layout = node->layout;
+    void** arrays[2];
+    size_t sizes[2];
+    const int count = relation_arrays(r, r->size, arrays, sizes);
+    for (int k = 0; k < count; k++) {
+        if (!read_array(pos, end, arrays[k], sizes[k])) {
+            return false;
+        }
+    }
+    if (!relation_loaded_valid(r, universe_size)) {
+        return false;
+    }
+    relation_convert(r, relation_fitting_layout(universe_size));
+    return relation_index(r);
+}
+
+/**
+ * @brief Load one store node from binary input
+ * @param pos Current position inside input
+ * @param end End of input
+ * @param store Store, node is appended to it
+ * @retval true - Node was loaded
+ * @retval false - Allocation failed or input is invalid
+ */
+bool load_store_node(const char** pos,
+                     const char* end,
+                     struct store* store) {
+    struct binary_node node;
+    if (!read_data(pos, end, &node, sizeof(node)) || node.size < 0) {
+        return false;
+    }
+
+    struct store_node* target = &store->nodes[store->size];
+    target->type = node.type;
+    target->in_arena = false;
+    target->version = 0;
+    switch (node.type) {
+        case SET: {
+            struct set* s = calloc(1, sizeof(struct set));
+            target->obj = s;
+            if (s == NULL) {
+                return false;
+            }
+            store->size++;
+            return load_set(pos, end, &node, s, store->universe->size);
+        }
+        case RELATION: {
+            struct relation* r = calloc(1, sizeof(struct relation));
+            target->obj = r;
+            if (r == NULL) {
+                return false;
+            }
+            store->size++;
+            return load_relation(pos, end, &node, r, store->universe->size);
+        }
+        case COMMAND: {
+            store->size++;
+            if (!read_array(pos, end, &target->obj, sizeof(struct command))) {
+                return false;
+            }
+            // Command is used to index definitions, don't trust it blindly
+            const struct command* c = target->obj;
+            const int count = sizeof(COMMAND_DEFS) / sizeof(COMMAND_DEFS[0]);
+            if (c->type < 0 || c->type >= count || c->argc < 0 ||
+                c->argc > MAX_COMMAND_ARGUMENTS) {
+                return false;
+            }
+            // Line numbers are positive, lines after file end fail when run
+            // same as in text input
+            for (int k = 0; k < c->argc; k++) {
+                if (c->args[k] < 1) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Load store from compiled binary input
+ * @param input Input
+ * @param store Store
+ * @retval true - Store was loaded
+ * @retval false - Allocation failed or input is invalid
+ */
+bool load_store(struct input* input, struct store* store) {
+    const char* pos = input->data;
+    const char* end = input->data + input->size;
+
+    struct binary_header header;
+    if (!read_data(&pos, end, &header, sizeof(header)) ||
+        header.version != BINARY_VERSION || header.universe_size < 0 ||
+        header.names_size < 0 || header.store_size < 1) {
+        return error("Invalid compiled file!\n");
+    }
+
+    // Store is allocated at once, its size is known
+    store->nodes = srealloc(store->nodes,
+                            sizeof(struct store_node) * header.store_size);
+    store->universe = calloc(1, sizeof(struct universe));
+    if (store->nodes == NULL || store->universe == NULL) {
+        return alloc_error();
+    }
+
+    // Load universe and generate its set, every name needs its offset
+    struct universe* u = store->universe;
+    u->size = header.universe_size;
+    if (u->size != 0 &&
+        ((size_t)u->size >= (size_t)(end - pos) / sizeof(int) ||
+         !read_array(&pos, end, (void**)&u->offsets,
+                     sizeof(int) * ((size_t)u->size + 1)) ||
+         !read_array(&pos, end, (void**)&u->names, header.names_size) ||
+         !universe_offsets_valid(u, header.names_size))) {
+        return error("Invalid compiled file!\n");
+    }
+    store->nodes[0].type = SET;
+    store->nodes[0].in_arena = false;
+    store->nodes[0].version = 0;
+    store->nodes[0].obj = get_set_from_universe(u);
+    if (store->nodes[0].obj == NULL) {
+        return alloc_error();
+    }
+    set_pack(store->nodes[0].obj, bitset_words(u->size));
+    store->size = 1;
+    if (!store_adopt(store, &store->nodes[0])) {
+        return alloc_error();
+    }
+
+    // Load remaining nodes
+    while (store->size < header.store_size) {
+        if (!load_store_node(&pos, end, store)) {
+            return error("Invalid compiled file!\n");
+        }
+        if (!store_adopt(store, &store->nodes[store->size - 1])) {
+            return alloc_error();
+        }
+    }
+
+    return true;
+}
+#pragma endregion
+#pragma region SPILL
+/*---------------------------------- SPILL ----------------------------------*/
+
+/**
+ * @brief Open temporary file for sets and relations that don't fit into
+ * memory while streaming
+ * @param spill Spill
+ * @retval true - File was opened
+ * @retval false - File couldn't be opened
+ */
+bool spill_open(struct spill* spill) {
+    spill->file = tmpfile();
+    if (spill->file == NULL) {
+        return error("Failed to open temporary file!\n");
+    }
+    spill->trigger = spill->limit;
+    return true;
+}
+
+/**
+ * @brief Get memory taken by set or relation of store node
+ * @param node Store node
+ * @return Size in bytes, 0 for commands and nodes moved out
+ */
+size_t store_node_bytes(struct store_node* node) {
+    if (node->obj == NULL || node->type == COMMAND) {
+        return 0;
+    }
+    if (node->type == SET) {
+        struct set* s = node->obj;
+        size_t size = sizeof(struct set);
+        if (s->layout == SET_BITSET) {
+            size += sizeof(uint64_t) * s->words;
+        } else if (s->layout == SET_RUNS) {
+            size += sizeof(struct set_run) * s->run_count;
+        } else {
+            size += sizeof(int) * s->size;
+        }
+        return size;
+    }
+    struct relation* r = node->obj;
+    void** arrays[2];
+    size_t sizes[2];
+    const int count = relation_arrays(r, r->size, arrays, sizes);
+    size_t size = sizeof(struct relation) +
+                  (r->rows == NULL ? 0 : sizeof(int) * (r->row_count + 1));
+    for (int k = 0; k < count; k++) {
+        size += sizes[k];
+    }
+    return size;
+}
+
+/**
+ * @brief Count set or relation of store node as kept in memory
+ * @param spill Spill
+ * @param node Store node
+ */
+void spill_track(struct spill* spill, struct store_node* node) {
+    if (spill->file != NULL) {
+        spill->resident += store_node_bytes(node);
+    }
+}
+
+/**
+ * @brief Move set or relation of store node into temporary file, node
+ * never changes after it became set or relation, so it is written only once
+ * @param store Store
+ * @param i Node index
+ * @retval true - Node was moved out
+ * @retval false - Allocation or write failed
+ */
+bool spill_node(struct store* store, int i) {
+    struct spill* spill = &store->spill;
+    if (spill->allocated < store->size) {
+        const int allocated = get_max(store->size, spill->allocated * 2);
+        long* offsets = realloc(spill->offsets, sizeof(long) * allocated);
+        if (offsets == NULL) {
+            return alloc_error();
+        }
+        for (int k = spill->allocated; k < allocated; k++) {
+            offsets[k] = -1;
+        }
+        spill->offsets = offsets;
+        spill->allocated = allocated;
+    }
+
+    struct store_node* node = &store->nodes[i];
+    if (spill->offsets[i] == -1) {
+        if (fseek(spill->file, 0, SEEK_END) != 0 ||
+            (spill->offsets[i] = ftell(spill->file)) == -1 ||
+            !write_node(spill->file, node)) {
+            spill->offsets[i] = -1;
+            return error("Failed to write temporary file!\n");
+        }
+    }
+    spill->resident -= store_node_bytes(node);
+    free_store_node(node);
+    node->obj = NULL;
+    return true;
+}
+
+/**
+ * @brief Load set or relation of store node back from temporary file
+ * @param store Store
+ * @param i Node index
+ * @retval true - Node is in memory
+ * @retval false - Allocation or read failed
+ */
+bool spill_load(struct store* store, int i) {
+    struct store_node* node = &store->nodes[i];
+    if (node->obj != NULL || node->type == COMMAND) {
+        return true;
+    }
+
+    struct spill* spill = &store->spill;
+    struct binary_node header;
+    if (fseek(spill->file, spill->offsets[i], SEEK_SET) != 0 ||
+        fread(&header, sizeof(header), 1, spill->file) != 1) {
+        return error("Failed to read temporary file!\n");
+    }
+    size_t size = 0;
+    if (node->type == SET && header.layout == SET_BITSET) {
+        size = sizeof(uint64_t) * header.count;
+    } else if (node->type == SET && header.layout == SET_RUNS) {
+        size = sizeof(struct set_run) * header.count;
+    } else if (node->type == SET) {
+        size = sizeof(int) * header.size;
+    } else {
+        struct relation shape = {.size = header.size, .layout = header.layout};
+        void** arrays[2];
+        size_t sizes[2];
+        const int count = relation_arrays(&shape, shape.size, arrays, sizes);
+        for (int k = 0; k < count; k++) {
+            size += sizes[k];
+        }
+    }
+    char* data = malloc(size == 0 ? 1 : size);
+    if (data == NULL) {
+        return alloc_error();
+    }
+    if (size != 0 && fread(data, size, 1, spill->file) != 1) {
+        free(data);
+        return error("Failed to read temporary file!\n");
+    }
+
+    // Data was written by this process, so only allocation can fail
+    const char* pos = data;
+    const int universe_size = store->universe->size;
+    bool loaded;
+    if (node->type == SET) {
+        node->obj = calloc(1, sizeof(struct set));
+        loaded = node->obj != NULL &&
+                 load_set(&pos, data + size, &header, node->obj, universe_size);
+    } else {
+        node->obj = calloc(1, sizeof(struct relation));
+        loaded = node->obj != NULL &&
+                 load_relation(&pos, data + size, &header, node->obj,
+                               universe_size);
+    }
+    free(data);
+    if (!loaded) {
+        free_store_node(node);
+        node->obj = NULL;
+        return alloc_error();
+    }
+    spill->resident += store_node_bytes(node);
+    return true;
+}
+
+/**
+ * @brief Load arguments of command back from temporary file
+ * @param store Store
+ * @param c Command with valid arguments
+ * @retval true - Arguments are in memory
+ * @retval false - Allocation or read failed
+ */
+bool spill_load_args(struct store* store, struct command* c) {
+    const int count = get_argument_count(COMMAND_DEFS[c->type].input);
+    for (int k = 0; k < count && k < c->argc; k++) {
+        if (!spill_load(store, c->args[k] - 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Move sets and relations that no waiting command reads into
+ * temporary file, once memory taken by them grows over trigger
+ *
+ * Lines before program counter were already run, so only commands from it
+ * on can read set or relation again. Jump back moves program counter back,
+ * so lines after jump target stay in memory. Line moved out by mistake is
+ * just loaded again when read.
+ * @param store Store
+ * @param pc Program counter - index of first node that wasn't run yet
+ * @retval true - Memory is under trigger
+ * @retval false - Allocation or write failed
+ */
+bool spill_cold(struct store* store, int pc) {
+    struct spill* spill = &store->spill;
+    if (spill->resident <= spill->trigger) {
+        return true;
+    }
+
+    bool* live = calloc(store->size, sizeof(bool));
+    if (live == NULL) {
+        return alloc_error();
+    }
+    for (int line = pc; line < store->size; line++) {
+        struct command* c = store->nodes[line].obj;
+        if (store->nodes[line].type != COMMAND) {
+            continue;
+        }
+        const int count = get_argument_count(COMMAND_DEFS[c->type].input);
+        for (int k = 0; k < count && k < c->argc; k++) {
+            if (c->args[k] >= 1 && c->args[k] <= store->size) {
+                live[c->args[k] - 1] = true;
+            }
+        }
+    }
+
+    // Oldest lines are moved first, half of limit is left for next lines
+    bool success = true;
+    for (int i = 0; success && i < store->size; i++) {
+        if (spill->resident <= spill->limit / 2) {
+            break;
+        }
+        if (!live[i] && store->nodes[i].type != COMMAND &&
+            store->nodes[i].obj != NULL) {
+            success = spill_node(store, i);
+        }
+    }
+    free(live);
+
+    // Lines that are read anyway may not fit, don't look at them every line
+    spill->trigger = spill->resident * 2 > spill->limit ? spill->resident * 2
+                                                        : spill->limit;
+    return success;
+}
 #pragma endregion
 #pragma region STORE RUNNER
 /*------------------------------- STORE RUNNER ------------------------------*/
 
 /**
- * @brief Function for making jumps inside file
+ * @brief Function for making jumps inside file
+ *
+ * @param input Input
+ * @param command Command
+ * @param i Program counter to be modified
+ */
+void make_jump(enum function_input input, struct command* command, int* i) {
+    int arg_count = get_argument_count(input);
+
+    // Jump
+    if (arg_count < command->argc) {
+        // Use last argument as new program counter location
+        // One -1 is for line to index mapping
+        // Second -1 is to account for i++ in next cycle
+        *i = command->args[command->argc - 1] - 2;
+    }
+}
+
+/**
+ * @brief Function for procesing bool ouput
+ * @param s Store
+ * @param r Result - bool or BOOL_ALLOC_ERROR
+ * @retval true - Function executed successfully
+ * @retval false - Function failed
+ */
+bool process_output_bool(struct store* s,
+                         unsigned char r,
+                         enum function_input input,
+                         struct command* command,
+                         int* i) {
+    if (r == BOOL_ALLOC_ERROR) {
+        return alloc_error();
+    }
+
+    // Print the actual bool
+    print_bool(&s->output, r);
+
+    // Handle jumping by modifying program counter
+    if (!r) {
+        make_jump(input, command, i);
+    }
+    return true;
+}
+
+/**
+ * @brief Function for processing set output
+ * @param s Store
+ * @param r Result - relation
+ * @param i Program counter
+ * @param shared Result is cached object shared with other node
+ * @retval true - Function executed successfully
+ * @retval false - Function failed
+ */
+bool process_output_relation(struct store* s,
+                             struct relation* r,
+                             int i,
+                             bool shared) {
+    // Check if function actually returned valid object
+    if (r == NULL) {
+        return false;
+    }
+
+    // Print the actual relation
+    print_relation(&s->output, r, s->universe);
+
+    // Replace command with actual relation in store
+    free_store_node(&s->nodes[i]);
+    s->nodes[i].type = RELATION;
+    s->nodes[i].obj = r;
+    s->nodes[i].in_arena = shared;
+    s->nodes[i].version++;
+    spill_track(&s->spill, &s->nodes[i]);
+
+    // Cached result already lives in arena
+    return shared || store_adopt(s, &s->nodes[i]) || alloc_error();
+}
+
+/**
+ * @brief Function for processing set output
+ * @param s Store
+ * @param r Result - set
+ * @param i Program counter
+ * @param shared Result is cached object shared with other node
+ * @retval true - Function executed successfully
+ * @retval false - Function failed
+ */
+bool process_output_set(struct store* s, struct set* r, int i, bool shared) {
+    // Check if function actually returned valid object
+    if (r == NULL) {
+        return false;
+    }
+
+    // Print the actual set
+    print_set(&s->output, r, s->universe, false);
+
+    // Replace command with actual set in store
+    free_store_node(&s->nodes[i]);
+    s->nodes[i].type = SET;
+    s->nodes[i].obj = r;
+    s->nodes[i].in_arena = shared;
+    s->nodes[i].version++;
+    spill_track(&s->spill, &s->nodes[i]);
+
+    // Cached result already lives in arena
+    return shared || store_adopt(s, &s->nodes[i]) || alloc_error();
+}
+
+/**
+ * @brief Process select output
  *
- * @param input Input
+ * @param s Set
+ * @param result Select result
+ * @param input Function input
  * @param command Command
- * @param i Program counter to be modified
+ * @param i Program counter
+ * @return true If everything went well
+ * @return false If malloc failed
  */
-void make_jump(enum function_input input, struct command* command, int* i) {
-    int arg_count = get_argument_count(input);
+bool process_output_select(struct store* s,
+                           struct select_result* result,
+                           enum function_input input,
+                           struct command* command,
+                           int* i) {
+    // Check malloc
+    if (result == NULL || result->error) {
+        return alloc_error();
+    }
 
-    // Jump
-    if (arg_count < command->argc) {
-        // Use last argument as new program counter location
-        // One -1 is for line to index mapping
-        // Second -1 is to account for i++ in next cycle
-        *i = command->args[command->argc - 1] - 2;
+    if (result->empty) {
+        // Jump
+        make_jump(input, command, i);
+    } else {
+        // Proccess this as normal set result
+        process_output_set(s, result->item, *i, false);
     }
+
+    // Free result
+    free(result);
+
+    return true;
 }
 
 /**
- * @brief Function for procesing bool ouput
- * @param r Result - bool
+ * @brief Retrieve object of store node, command is mapped to empty object
+ * @param s Store
+ * @param index Node index
+ * @param type Expected type
+ * @return Node object
+ */
+void* retrieve_node(struct store* s, int index, enum store_node_type type) {
+    struct store_node node = s->nodes[index];
+
+    // If node is command we have to map it to correct empty object
+    if (node.type == COMMAND) {
+        // Return object based on expected type
+        if (type == SET) {
+            // Return empty set
+            return s->empty_set;
+        } else {
+            // Return empty relation
+            return s->empty_relation;
+        }
+    } else {
+        return node.obj;
+    }
+}
+
+/**
+ * @brief Retrieve argument for function, mainly for empty set and relation
+ * handling
+ *
+ * @param s Store
+ * @param c Command
+ * @param arg_index Argument index
+ * @param type Expected argument type
+ * @return Function argument
+ */
+void* retrieve_arg(struct store* s,
+                   struct command* c,
+                   int arg_index,
+                   enum store_node_type type) {
+    return retrieve_node(s, c->args[arg_index] - 1, type);
+}
+
+/**
+ * @brief Retrieve all function arguments of command
+ * @param s Store
+ * @param c Command
+ * @param input Function input
+ * @param args Function arguments to be filled
+ */
+void retrieve_args(struct store* s,
+                   struct command* c,
+                   enum function_input input,
+                   void* args[]) {
+    for (int k = 0; k < get_argument_count(input); k++) {
+        // Select works with store node itself
+        args[k] = input == IN_ANY
+                      ? (void*)&s->nodes[c->args[k] - 1]
+                      : retrieve_arg(s, c, k, get_argument_type(input, k));
+    }
+}
+
+/**
+ * @brief Execute function that corresponds
+ * to the given command and return pointer to the result
+ * @param s Store
+ * @param args Function arguments
+ * @param def Command definition
+ * @param threads Number of threads command can use
+ * @return void pointer to result of command function
+ */
+void* process_function_input(struct store* s,
+                             void* args[],
+                             struct command_def def,
+                             int threads) {
+    switch (def.input) {
+        case IN_SET: {
+            void* (*f)(struct set*) = def.function;
+            return f(args[0]);
+        }
+        case IN_SET_SET: {
+            void* (*f)(struct set*, struct set*) = def.function;
+            return f(args[0], args[1]);
+        }
+        case IN_SET_UNIVERSE: {
+            void* (*f)(struct set*, struct universe*) = def.function;
+            return f(args[0], s->universe);
+        }
+        case IN_RELATION: {
+            void* (*f)(struct relation*) = def.function;
+            return f(args[0]);
+        }
+        case IN_RELATION_UNIVERSE: {
+            void* (*f)(struct relation*, struct universe*) = def.function;
+            return f(args[0], s->universe);
+        }
+        case IN_RELATION_THREADS: {
+            void* (*f)(struct relation*, int) = def.function;
+            return f(args[0], threads);
+        }
+        case IN_RELATION_SET_SET: {
+            void* (*f)(struct relation*, struct set*, struct set*) =
+                def.function;
+            return f(args[0], args[1], args[2]);
+        }
+        case IN_ANY: {
+            void* (*f)(struct store_node*) = def.function;
+            return f(args[0]);
+        }
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Look up cached result of command and count hit or miss
+ * @param store Store
+ * @param def Command definition
+ * @param key Cache key of command
+ * @return Cache entry, NULL when result has to be computed
+ */
+struct memo_entry* command_lookup(struct store* store,
+                                  struct command_def def,
+                                  const struct memo_entry* key) {
+    // Same command over unchanged arguments gives same result, except select
+    // that picks random item
+    if (def.output == OUT_SELECT || store->memo.disabled) {
+        return NULL;
+    }
+    struct memo_entry* cached = memo_find(&store->memo, key);
+    if (cached != NULL) {
+        store->memo.hits++;
+    } else {
+        store->memo.misses++;
+    }
+    return cached;
+}
+
+/**
+ * @brief Process result of command and cache it
+ * @param store Store
+ * @param command Command, it is freed when its node is replaced
+ * @param def Command definition
+ * @param key Cache key of command
+ * @param cached Result was taken from cache
+ * @param result Result of command function
+ * @param i Program counter
+ * @retval true - Result processed successfully
+ * @retval false - Function failed
+ */
+bool process_command_output(struct store* store,
+                            struct command* command,
+                            struct command_def def,
+                            const struct memo_entry* key,
+                            bool cached,
+                            void* result,
+                            int* i) {
+    const int line = *i;
+    bool success = true;
+    switch (def.output) {
+        case OUT_SET:;
+            success = process_output_set(store, result, line, cached);
+            // Cache set only after it was moved into arena
+            result = store->nodes[line].obj;
+            break;
+        case OUT_RELATION:;
+            success = process_output_relation(store, result, line, cached);
+            result = store->nodes[line].obj;
+            break;
+        case OUT_BOOL:;
+            // Bool is returned in place of pointer, only lowest byte is set
+            success =
+                process_output_bool(store, (unsigned char)(uintptr_t)result,
+                                    def.input, command, i);
+            break;
+        case OUT_NUMBER:
+            // Number is returned in place of pointer, same as bool
+            print_number(&store->output, (int)(intptr_t)result);
+            break;
+        case OUT_SELECT:
+            return process_output_select(store, result, def.input, command, i);
+    }
+
+    // Failed insert only means result won't be reused
+    if (success && !cached) {
+        memo_insert(&store->memo, key, result);
+    }
+    return success;
+}
+
+/**
+ * @brief Function for running commands
+ * @param command Command
+ * @param store Store
+ * @param i Program counter
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_output_bool(bool r,
-                         enum function_input input,
-                         struct command* command,
-                         int* i) {
-    // Print the actual bool
-    print_bool(r);
+bool run_command(struct command* command, struct store* store, int* i) {
+    struct command_def def = COMMAND_DEFS[command->type];
 
-    // Handle jumping by modifying program counter
-    if (!r) {
-        make_jump(input, command, i);
+    if (!command_arguments_valid(command, store, def)) {
+        return error("Invalid command arguments!\n");
+    }
+    if (!spill_load_args(store, command)) {
+        return false;
+    }
+
+    struct memo_entry key;
+    memo_key(store, command, def.input, &key);
+    struct memo_entry* cached = command_lookup(store, def, &key);
+    void* result;
+    if (cached != NULL) {
+        result = cached->result;
+    } else {
+        void* args[MAX_COMMAND_ARGUMENTS];
+        retrieve_args(store, command, def.input, args);
+        result = process_function_input(store, args, def, store->threads);
+    }
+    return process_command_output(store, command, def, &key, cached != NULL,
+                                  result, i);
+}
+
+/**
+ * @brief Check if all lines referenced by command were already read
+ * @param command Command
+ * @param store Store
+ * @retval true - Command can be run
+ * @retval false - Command references line that wasn't read yet
+ */
+bool command_ready(struct command* command, struct store* store) {
+    for (int i = 0; i < command->argc; i++) {
+        if (command->args[i] > store->size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Plan command of schedule, commands that can jump or fail are left
+ * to be run alone
+ *
+ * Argument replaced by earlier command of schedule becomes dependency, its
+ * node version is counted as already replaced for cache key.
+ * @param job Schedule job
+ * @param line Index of command line
+ * @param streaming Commands referencing lines that weren't read yet can't run
+ * @retval true - Command was planned
+ * @retval false - Command ends schedule
+ */
+bool schedule_command(struct schedule_job* job, int line, bool streaming) {
+    struct store* store = job->store;
+    struct command* c = store->nodes[line].obj;
+    struct command_def def = COMMAND_DEFS[c->type];
+    const int count = get_argument_count(def.input);
+    if ((streaming && !command_ready(c, store)) ||
+        def.output == OUT_SELECT || c->argc > count ||
+        !command_arguments_valid(c, store, def) || !spill_load_args(store, c)) {
+        return false;
+    }
+
+    struct scheduled_command* sc = &job->commands[line - job->begin];
+    memo_key(store, c, def.input, &sc->key);
+    retrieve_args(store, c, def.input, sc->args);
+    int level = 0;
+    for (int k = 0; k < count; k++) {
+        const int arg = c->args[k] - 1;
+        sc->sources[k] = -1;
+        if (arg < job->begin || arg >= line ||
+            job->commands[arg - job->begin].type == COMMAND) {
+            continue;
+        }
+        // Type is checked against node before it gets replaced
+        struct scheduled_command* source = &job->commands[arg - job->begin];
+        if (source->type != get_argument_type(def.input, k)) {
+            return false;
+        }
+        sc->sources[k] = source->alias != -1 ? source->alias : arg - job->begin;
+        sc->key.versions[k]++;
+        level = get_max(level, job->commands[sc->sources[k]].level + 1);
+    }
+
+    sc->type = get_result_type(def.output);
+    // Same command planned earlier counts as cache hit, results aren't
+    // shared while streaming so every line owns its set or relation
+    struct memo_entry* planned =
+        store->memo.disabled ? NULL : memo_find(&job->planned, &sc->key);
+    struct memo_entry* cached = NULL;
+    if (planned != NULL) {
+        store->memo.hits++;
+        sc->alias = (int)(intptr_t)planned->result;
+    } else {
+        cached = command_lookup(store, def, &sc->key);
+    }
+    sc->cached = cached != NULL || planned != NULL;
+    sc->result = cached != NULL ? cached->result : NULL;
+    // Known result doesn't delay dependent commands
+    if (sc->cached) {
+        sc->level = -1;
+    } else {
+        sc->level = level;
+        memo_insert(&job->planned, &sc->key,
+                    (void*)(intptr_t)(line - job->begin));
+    }
+    return true;
+}
+
+/**
+ * @brief Compute result of planned command, its dependencies are computed
+ * @param job Schedule job
+ * @param index Index of command inside schedule
+ */
+void schedule_compute(struct schedule_job* job, int index) {
+    struct scheduled_command* sc = &job->commands[index];
+    struct command* c = job->store->nodes[job->begin + index].obj;
+    struct command_def def = COMMAND_DEFS[c->type];
+    for (int k = 0; k < get_argument_count(def.input); k++) {
+        if (sc->sources[k] != -1) {
+            // Failed dependency is reported when its line is processed
+            sc->args[k] = job->commands[sc->sources[k]].result;
+            if (sc->args[k] == NULL) {
+                return;
+            }
+        }
+    }
+    sc->result =
+        process_function_input(job->store, sc->args, def, job->threads);
+}
+
+/**
+ * @brief Worker computing commands of one schedule level
+ * @param arg Schedule job
+ * @return Always NULL
+ */
+void* schedule_worker(void* arg) {
+    struct schedule_job* job = arg;
+    int i;
+    while ((i = work_queue_take(&job->queue)) != -1) {
+        schedule_compute(job, job->order[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Compute commands of one level, they don't depend on each other
+ * @param job Schedule job
+ * @param from Index of first command inside order
+ * @param to Index after last command inside order
+ * @retval true - Commands were computed
+ * @retval false - Lock couldn't be created
+ */
+bool schedule_level(struct schedule_job* job, int from, int to) {
+    // Estimate work by size of arguments, small levels aren't worth threads
+    size_t items = 0;
+    for (int i = from; i < to; i++) {
+        struct scheduled_command* sc = &job->commands[job->order[i]];
+        struct command* c = job->store->nodes[job->begin + job->order[i]].obj;
+        const enum function_input input = COMMAND_DEFS[c->type].input;
+        for (int k = 0; k < get_argument_count(input); k++) {
+            void* arg = sc->sources[k] != -1
+                            ? job->commands[sc->sources[k]].result
+                            : sc->args[k];
+            if (arg != NULL) {
+                items += get_argument_type(input, k) == SET
+                             ? ((struct set*)arg)->size
+                             : ((struct relation*)arg)->size;
+            }
+        }
+    }
+    const int threads = items < PARALLEL_MIN_ITEMS
+                            ? 1
+                            : get_min(job->store->threads, to - from);
+    // Commands share threads left by level, so level never runs more
+    // threads than were given
+    job->threads = get_max(job->store->threads / threads, 1);
+
+    if (!work_queue_init(&job->queue, from, to)) {
+        return false;
+    }
+    run_parallel(schedule_worker, job, threads);
+    work_queue_destroy(&job->queue);
+    return true;
+}
+
+/**
+ * @brief Free computed results of schedule lines that weren't processed
+ * @param job Schedule job
+ * @param from Index of first line that wasn't processed
+ * @param end Index after last line of schedule
+ */
+void schedule_free(struct schedule_job* job, int from, int end) {
+    for (int line = from; line < end; line++) {
+        struct scheduled_command* sc = &job->commands[line - job->begin];
+        if (sc->cached || sc->result == NULL) {
+            continue;
+        }
+        if (sc->type == SET) {
+            free_set(sc->result);
+        } else if (sc->type == RELATION) {
+            free_relation(sc->result);
+        }
+    }
+}
+
+/**
+ * @brief Process lines of schedule in line order
+ * @param job Schedule job
+ * @param end Index after last line of schedule
+ * @retval true - All lines were processed
+ * @retval false - Some command failed
+ */
+bool schedule_commit(struct schedule_job* job, int end) {
+    struct store* store = job->store;
+    for (int line = job->begin; line < end; line++) {
+        struct store_node* node = &store->nodes[line];
+        struct scheduled_command* sc = &job->commands[line - job->begin];
+        if (!spill_load(store, line)) {
+            schedule_free(job, line, end);
+            return false;
+        }
+        if (node->type == SET) {
+            print_set(&store->output, node->obj, store->universe, line == 0);
+        } else if (node->type == RELATION) {
+            print_relation(&store->output, node->obj, store->universe);
+        } else {
+            struct command* c = node->obj;
+            int i = line;
+            // Set and relation of alias were moved into arena already
+            if (sc->alias != -1) {
+                struct scheduled_command* original = &job->commands[sc->alias];
+                sc->result = original->type == COMMAND
+                                 ? original->result
+                                 : store->nodes[job->begin + sc->alias].obj;
+            }
+            if (!process_command_output(store, c, COMMAND_DEFS[c->type],
+                                        &sc->key, sc->cached, sc->result,
+                                        &i)) {
+                schedule_free(job, line + 1, end);
+                return false;
+            }
+        }
     }
     return true;
 }
 
 /**
- * @brief Function for processing set output
- * @param s Store
- * @param r Result - relation
- * @param i Program counter
- * @retval true - Function executed successfully
- * @retval false - Function failed
+ * @brief Run lines up to next command that can jump as dependency graph
+ *
+ * Commands only read lines before them and replace their own line, so
+ * command depends on earlier commands replacing its arguments. Commands
+ * without dependencies between them are computed on multiple threads, level
+ * by level. Output, arena and cache are then processed in line order.
+ * @param store Store
+ * @param pc Program counter, moved to first line that wasn't run
+ * @param streaming Stop at commands referencing lines that weren't read yet
+ * @retval true - Lines were run successfully
+ * @retval false - Some command failed
  */
-bool process_output_relation(struct store* s, struct relation* r, int i) {
-    // Check if function actually returned valid object
-    if (r == NULL) {
-        return false;
+bool schedule_run(struct store* store, int* pc, bool streaming) {
+    struct schedule_job job = {.store = store, .begin = *pc};
+    int allocated = INITIAL_STORE_ALLOC;
+    job.commands = malloc(sizeof(struct scheduled_command) * allocated);
+    if (job.commands == NULL) {
+        return alloc_error();
     }
 
-    // Print the actual relation
-    print_relation(r, s->universe);
+    // Plan lines until command that has to run alone
+    int end = *pc;
+    int computed = 0;
+    int levels = 0;
+    for (; end < store->size; end++) {
+        if (!smart_realloc((void**)&job.commands, end - job.begin + 1,
+                           &allocated, sizeof(struct scheduled_command))) {
+            free(job.planned.entries);
+            return alloc_error();
+        }
+        struct scheduled_command* sc = &job.commands[end - job.begin];
+        sc->type = COMMAND;
+        sc->level = -1;
+        sc->alias = -1;
+        sc->cached = false;
+        sc->result = NULL;
+        if (store->nodes[end].type == COMMAND &&
+            !schedule_command(&job, end, streaming)) {
+            break;
+        }
+        if (sc->level >= 0) {
+            computed++;
+            levels = get_max(levels, sc->level + 1);
+        }
+    }
 
-    // Replace command with actual relation in store
-    free_command(s->nodes[i].obj);
-    s->nodes[i].type = RELATION;
-    s->nodes[i].obj = r;
+    // Sort computed commands by level, starts end up at ends of levels
+    job.order = malloc(sizeof(int) * (computed + 1));
+    int* starts = calloc(levels + 1, sizeof(int));
+    bool success = job.order != NULL && starts != NULL;
+    for (int k = 0; success && k < end - job.begin; k++) {
+        if (job.commands[k].level >= 0) {
+            starts[job.commands[k].level + 1]++;
+        }
+    }
+    for (int l = 1; success && l <= levels; l++) {
+        starts[l] += starts[l - 1];
+    }
+    for (int k = 0; success && k < end - job.begin; k++) {
+        if (job.commands[k].level >= 0) {
+            job.order[starts[job.commands[k].level]++] = k;
+        }
+    }
 
-    return true;
+    // Compute levels in order, then process all lines
+    for (int l = 0; success && l < levels; l++) {
+        success = schedule_level(&job, l == 0 ? 0 : starts[l - 1], starts[l]);
+    }
+    if (success) {
+        success = schedule_commit(&job, end);
+    } else {
+        schedule_free(&job, job.begin, end);
+        alloc_error();
+    }
+    free(starts);
+    free(job.order);
+    free(job.commands);
+    free(job.planned.entries);
+    *pc = end;
+    return success;
 }
 
 /**
- * @brief Function for processing set output
- * @param s Store
- * @param r Result - set
- * @param i Program counter
+ * @brief Run store nodes starting at program counter
+ * @param store Store
+ * @param pc Program counter - index of first node that wasn't run yet
+ * @param streaming Pause at commands referencing lines that weren't read yet
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_output_set(struct store* s, struct set* r, int i) {
-    // Check if function actually returned valid object
-    if (r == NULL) {
-        return false;
+bool store_run(struct store* store, int* pc, bool streaming) {
+    for (; *pc < store->size; (*pc)++) {
+        // Lines up to next possible jump are run by scheduler
+        if (store->schedule) {
+            if (!schedule_run(store, pc, streaming)) {
+                return error("Error running command!\n");
+            }
+            if (*pc == store->size) {
+                break;
+            }
+        }
+        if (!spill_load(store, *pc)) {
+            return false;
+        }
+        switch (store->nodes[*pc].type) {
+            case SET:
+                print_set(&store->output, store->nodes[*pc].obj,
+                          store->universe, *pc == 0);
+                break;
+            case RELATION:
+                print_relation(&store->output, store->nodes[*pc].obj,
+                               store->universe);
+                break;
+            case COMMAND:
+                // Wait for more lines, command will be run after next read
+                if (streaming && !command_ready(store->nodes[*pc].obj, store)) {
+                    return true;
+                }
+                // Command can modify program counter
+                if (!run_command(store->nodes[*pc].obj, store, pc)) {
+                    return error("Error running command!\n");
+                };
+                break;
+        }
     }
 
-    // Print the actual set
-    print_set(r, s->universe, false);
-
-    // Replace command with actual set in store
-    free_command(s->nodes[i].obj);
-    s->nodes[i].type = SET;
-    s->nodes[i].obj = r;
-
     return true;
 }
+#pragma endregion
+#pragma region BYTECODE
+/*--------------------------------- BYTECODE --------------------------------*/
 
 /**
- * @brief Process select output
+ * @brief Compile store line into instruction
  *
- * @param s Set
- * @param result Select result
- * @param input Function input
- * @param command Command
- * @param i Program counter
- * @return true If everything went well
- * @return false If malloc failed
+ * Argument is checked again when run only when its line can be replaced by
+ * result of other type, until then it is valid empty object.
+ * @param store Store
+ * @param line Line index
+ * @param in Instruction
  */
-bool process_output_select(struct store* s,
-                           struct select_result* result,
-                           enum function_input input,
-                           struct command* command,
-                           int* i) {
-    // Check malloc
-    if (result == NULL || result->error) {
-        return alloc_error();
+void instruction_compile(struct store* store,
+                         int line,
+                         struct instruction* in) {
+    struct store_node* node = &store->nodes[line];
+    in->command = NULL;
+    in->def = NULL;
+    in->checked = false;
+    in->jumps = false;
+    if (node->type != COMMAND) {
+        in->op = node->type == SET ? OP_PRINT_SET : OP_PRINT_RELATION;
+        return;
     }
 
-    if (result->empty) {
-        // Jump
-        make_jump(input, command, i);
-    } else {
-        // Proccess this as normal set result
-        process_output_set(s, result->item, *i);
+    in->command = node->obj;
+    in->def = &COMMAND_DEFS[in->command->type];
+    // Invalid command fails when it is reached
+    if (!command_arguments_valid(in->command, store, *in->def)) {
+        in->op = OP_INVALID;
+        return;
     }
+    const enum function_input input = in->def->input;
+    const int count = get_argument_count(input);
+    in->op = OP_SET + input;
+    in->jumps = in->def->output == OUT_SELECT || in->command->argc > count;
+    for (int k = 0; k < count; k++) {
+        in->args[k] = in->command->args[k] - 1;
+        // Command line gets type of its result
+        struct store_node* arg = &store->nodes[in->args[k]];
+        struct command* c = arg->obj;
+        const enum store_node_type type =
+            arg->type == COMMAND ? get_result_type(COMMAND_DEFS[c->type].output)
+                                 : arg->type;
+        if (input != IN_ANY && type != COMMAND &&
+            type != get_argument_type(input, k)) {
+            in->checked = true;
+        }
+    }
+}
 
-    // Free result
-    free(result);
-
+/**
+ * @brief Compile store lines into program, arguments of commands are
+ * resolved and checked once
+ * @param store Store
+ * @param program Program
+ * @retval true - Program was compiled
+ * @retval false - Allocation failed
+ */
+bool program_compile(struct store* store, struct program* program) {
+    program->size = store->size + 1;
+    program->code = malloc(sizeof(struct instruction) * program->size);
+    if (program->code == NULL) {
+        return alloc_error();
+    }
+    for (int i = 0; i < store->size; i++) {
+        instruction_compile(store, i, &program->code[i]);
+    }
+    program->code[store->size].op = OP_HALT;
+    program->code[store->size].command = NULL;
     return true;
 }
 
 /**
- * @brief Retrieve argument for function, mainly for empty set and relation
- * handling
- *
- * @param s Store
- * @param c Command
- * @param arg_index Argument index
- * @param type Expected argument type
- * @return Function argument
+ * @brief Turn instructions of lines replaced by their result into printing
+ * @param program Program
+ * @param store Store
+ * @param from Index of first instruction
+ * @param to Index after last instruction
  */
-void* retrieve_arg(struct store* s,
-                   struct command* c,
-                   int arg_index,
-                   enum store_node_type type) {
-    struct store_node node = s->nodes[c->args[arg_index] - 1];
-
-    // If node is command we have to map it to correct empty object
-    if (node.type == COMMAND) {
-        // Return object based on expected type
-        if (type == SET) {
-            // Return empty set
-            return s->empty_set;
-        } else {
-            // Return empty relation
-            return s->empty_relation;
+void program_refresh(struct program* program,
+                     struct store* store,
+                     int from,
+                     int to) {
+    for (int i = from; i < to; i++) {
+        struct instruction* in = &program->code[i];
+        if (in->op >= OP_SET && in->op <= OP_ANY &&
+            store->nodes[i].type != COMMAND) {
+            in->command = NULL;
+            in->op = store->nodes[i].type == SET ? OP_PRINT_SET
+                                                 : OP_PRINT_RELATION;
         }
-    } else {
-        return node.obj;
     }
 }
 
 /**
- * @brief Execute function that corresponds
- * to the given command and return pointer to the result
- * @param s Store
- * @param c Command
- * @param def Command definition
- * @return void pointer to result of command function
+ * @brief Compute result of command instruction from its resolved arguments
+ * @param store Store
+ * @param in Instruction
+ * @return Result of command function
  */
-void* process_function_input(struct store* s,
-                             struct command* c,
-                             struct command_def def) {
-    switch (def.input) {
-        case IN_SET: {
-            void* (*f)(struct set*) = def.function;
-            return f(retrieve_arg(s, c, 0, SET));
+void* instruction_compute(struct store* store, struct instruction* in) {
+    switch (in->op) {
+        case OP_SET: {
+            void* (*f)(struct set*) = in->def->function;
+            return f(retrieve_node(store, in->args[0], SET));
         }
-        case IN_SET_SET: {
-            void* (*f)(struct set*, struct set*) = def.function;
-            return f(retrieve_arg(s, c, 0, SET), retrieve_arg(s, c, 1, SET));
+        case OP_SET_SET: {
+            void* (*f)(struct set*, struct set*) = in->def->function;
+            return f(retrieve_node(store, in->args[0], SET),
+                     retrieve_node(store, in->args[1], SET));
         }
-        case IN_SET_UNIVERSE: {
-            void* (*f)(struct set*, struct universe*) = def.function;
-            return f(retrieve_arg(s, c, 0, SET), s->universe);
+        case OP_SET_UNIVERSE: {
+            void* (*f)(struct set*, struct universe*) = in->def->function;
+            return f(retrieve_node(store, in->args[0], SET), store->universe);
         }
-        case IN_RELATION: {
-            void* (*f)(struct relation*) = def.function;
-            return f(retrieve_arg(s, c, 0, RELATION));
+        case OP_RELATION: {
+            void* (*f)(struct relation*) = in->def->function;
+            return f(retrieve_node(store, in->args[0], RELATION));
         }
-        case IN_RELATION_UNIVERSE: {
-            void* (*f)(struct relation*, struct universe*) = def.function;
-            return f(retrieve_arg(s, c, 0, RELATION), s->universe);
+        case OP_RELATION_UNIVERSE: {
+            void* (*f)(struct relation*, struct universe*) = in->def->function;
+            return f(retrieve_node(store, in->args[0], RELATION),
+                     store->universe);
         }
-        case IN_RELATION_SET_SET: {
+        case OP_RELATION_THREADS: {
+            void* (*f)(struct relation*, int) = in->def->function;
+            return f(retrieve_node(store, in->args[0], RELATION),
+                     store->threads);
+        }
+        case OP_RELATION_SET_SET: {
             void* (*f)(struct relation*, struct set*, struct set*) =
-                def.function;
-            return f(retrieve_arg(s, c, 0, RELATION),
-                     retrieve_arg(s, c, 1, SET), retrieve_arg(s, c, 2, SET));
+                in->def->function;
+            return f(retrieve_node(store, in->args[0], RELATION),
+                     retrieve_node(store, in->args[1], SET),
+                     retrieve_node(store, in->args[2], SET));
         }
-        case IN_ANY: {
-            void* (*f)(struct store_node*) = def.function;
-            return f(&s->nodes[c->args[0] - 1]);
+        default: {
+            void* (*f)(struct store_node*) = in->def->function;
+            return f(&store->nodes[in->args[0]]);
         }
-        default:
-            return NULL;
     }
 }
 
 /**
- * @brief Function for running commands
- * @param command Command
+ * @brief Run command instruction at program counter
+ *
+ * Commands without jumps are handed to scheduler when thread count was set.
+ * @param program Program
  * @param store Store
- * @param i Program counter
- * @retval true - Function executed successfully
- * @retval false - Function failed
+ * @param pc Program counter, moved to next instruction to be run
+ * @retval true - Command executed successfully
+ * @retval false - Command failed
  */
-bool run_command(struct command* command, struct store* store, int* i) {
-    struct command_def def = COMMAND_DEFS[command->type];
-
-    if (!command_arguments_valid(command, store, def)) {
-        return error("Invalid command arguments!\n");
-    }
-
-    void* result = process_function_input(store, command, def);
-
-    switch (def.output) {
-        case OUT_SET:;
-            return process_output_set(store, result, *i);
-        case OUT_RELATION:;
-            return process_output_relation(store, result, *i);
-        case OUT_BOOL:;
-            return process_output_bool(result, def.input, command, i);
-        case OUT_VOID:
+bool instruction_run(struct program* program, struct store* store, int* pc) {
+    struct instruction* in = &program->code[*pc];
+    // Scheduler runs command together with following lines up to next jump
+    if (store->schedule && !in->jumps) {
+        const int from = *pc;
+        if (!schedule_run(store, pc, false)) {
+            return error("Error running command!\n");
+        }
+        program_refresh(program, store, from, *pc);
+        if (*pc != from) {
             return true;
-        case OUT_SELECT:
-            return process_output_select(store, result, def.input, command, i);
+        }
     }
+    if (in->checked &&
+        !command_arguments_valid(in->command, store, *in->def)) {
+        error("Invalid command arguments!\n");
+        return error("Error running command!\n");
+    }
+    struct memo_entry key;
+    memo_key(store, in->command, in->def->input, &key);
+    struct memo_entry* cached = command_lookup(store, *in->def, &key);
+    void* result =
+        cached != NULL ? cached->result : instruction_compute(store, in);
+    // Command can move program counter by jump
+    int line = *pc;
+    if (!process_command_output(store, in->command, *in->def, &key,
+                                cached != NULL, result, &line)) {
+        return error("Error running command!\n");
+    }
+    program_refresh(program, store, *pc, *pc + 1);
+    *pc = line + 1;
     return true;
 }
 
 /**
- * @brief Function for running all things inside store
+ * @brief Run compiled program
+ * @param program Program
  * @param store Store
- * @retval true - Function executed successfully
- * @retval false - Function failed
+ * @retval true - Program executed successfully
+ * @retval false - Some command failed
  */
-bool store_runner(struct store* store) {
-    for (int i = 0; i < store->size; i++) {
-        switch (store->nodes[i].type) {
-            case SET:
-                print_set(store->nodes[i].obj, store->universe, i == 0);
+bool program_run(struct program* program, struct store* store) {
+    int pc = 0;
+    while (true) {
+        switch (program->code[pc].op) {
+            case OP_PRINT_SET:
+                print_set(&store->output, store->nodes[pc].obj,
+                          store->universe, pc == 0);
+                pc++;
                 break;
-            case RELATION:
-                print_relation(store->nodes[i].obj, store->universe);
+            case OP_PRINT_RELATION:
+                print_relation(&store->output, store->nodes[pc].obj,
+                               store->universe);
+                pc++;
                 break;
-            case COMMAND:
-                // Command can modify program counter
-                if (!run_command(store->nodes[i].obj, store, &i)) {
-                    return error("Error running command!\n");
-                };
+            case OP_INVALID:
+                error("Invalid command arguments!\n");
+                return error("Error running command!\n");
+            case OP_HALT:
+                return true;
+            default:
+                if (!instruction_run(program, store, &pc)) {
+                    return false;
+                }
                 break;
         }
     }
+}
 
-    return true;
+/**
+ * @brief Function for running all things inside store
+ * @param store Store
+ * @retval true - Function executed successfully
+ * @retval false - Function failed
+ */
+bool store_runner(struct store* store) {
+    struct program program;
+    if (!program_compile(store, &program)) {
+        return false;
+    }
+    bool result = program_run(&program, store);
+    free(program.code);
+    return result;
 }
 #pragma endregion
 #pragma region FILE PARSING
 /*------------------------------- FILE PARSING ------------------------------*/
 
+/**
+ * @brief Find character inside buffer
+ * @param pos Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to be found
+ * @return Pointer to first occurrence of character, end if it wasn't found
+ */
+const char* find_char(const char* pos, const char* end, char c) {
+    const char* found = memchr(pos, c, end - pos);
+    return found == NULL ? end : found;
+}
+
 /**
  * @brief Parse line number
- * @param string String to be parsed
+ * @param string Number token (not terminated)
+ * @param length Token length
  * @param result Result
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool parse_line_number(char* string, int* result) {
+bool parse_line_number(const char* string, int length, int* result) {
+    // Line numbers are short, copy them so strtol has terminated string
+    if (length > MAX_STRING_LENGTH) {
+        return error("Command (argument) too long!\n");
+    }
+    char buffer[STRING_BUFFER_SIZE];
+    memcpy(buffer, string, length);
+    buffer[length] = '\0';
+
     char* end_p;
-    long number = strtol(string, &end_p, 10);
+    long number = strtol(buffer, &end_p, 10);
 
     // Check if string starts with number, also check if it ends with number
-    if (end_p == string || *end_p != '\0') {
+    if (end_p == buffer || *end_p != '\0') {
         return error("Invalid characters inside number!\n");
     }
     // Check if number is positive
@@ -1788,43 +6337,44 @@ bool parse_line_number(char* string, int* result) {
 }
 
 /**
- * @brief Parse universe from file stream
- * @param fp File pointer
+ * @brief Parse universe from line
+ * @param pos Start of line content
+ * @param end End of line
  * @param u Universe
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool parse_universe(FILE* fp, struct universe* u) {
-    // Allocate memory for 1 node
-    u->nodes = calloc(sizeof(*u->nodes), 1);
+bool parse_universe(const char* pos, const char* end, struct universe* u) {
+    // Count nodes first so we can allocate them at once
     u->size = 1;
+    for (const char* p = pos; (p = find_char(p, end, ' ')) != end; p++) {
+        u->size++;
+    }
+    // Names are packed without separators, so they take the line without
+    // spaces
+    u->offsets = malloc(sizeof(int) * (u->size + 1));
+    u->names = malloc((end - pos) - (u->size - 1) + 1);
+    if (u->offsets == NULL || u->names == NULL) {
+        return alloc_error();
+    }
 
-    int index = 0;
-
-    while (true) {
-        int c = getc(fp);
-        // If character is EOF or newline we can end parsing
-        if (c == EOF || c == '\n') {
-            break;
-            // If character is space create new node
-        } else if (c == ' ') {
-            u->size++;
-            index = 0;
-            u->nodes = srealloc(u->nodes, sizeof(*u->nodes) * u->size);
-            memset(u->nodes[u->size - 1], 0, STRING_BUFFER_SIZE);
-            continue;
-            // Handle invalid characters
-        } else if (!isalpha(c)) {
-            return error("Invalid character in universe\n");
-        }
+    int offset = 0;
+    for (int i = 0; i < u->size; i++) {
+        const char* token_end = find_char(pos, end, ' ');
+        const int length = token_end - pos;
 
-        if (index >= MAX_STRING_LENGTH) {
-            return error("Element name too long!\n");
+        // Handle invalid characters
+        for (int k = 0; k < length; k++) {
+            if (!isalpha((unsigned char)pos[k])) {
+                return error("Invalid character in universe\n");
+            }
         }
-
-        u->nodes[u->size - 1][index] = c;
-        index++;
+        u->offsets[i] = offset;
+        memcpy(u->names + offset, pos, length);
+        offset += length;
+        pos = token_end + 1;
     }
+    u->offsets[u->size] = offset;
 
     return true;
 }
@@ -1833,28 +6383,37 @@ bool parse_universe(FILE* fp, struct universe* u) {
  * @brief Find element from universe and set it in set
  * @param u Universe
  * @param s Set
+ * @param name Element name (not terminated)
+ * @param length Element name length
  * @return true When element from universe was found
  * @return false When element wasn't found
  */
-bool set_set_node(struct universe* u, struct set* s, char* buffer) {
-    for (int i = 0; i < u->size; i++) {
-        if (!(strcmp(buffer, u->nodes[i]))) {
-            s->nodes[s->size - 1] = i;
-            return true;
-        }
+bool set_set_node(struct universe* u,
+                  struct set* s,
+                  const char* name,
+                  int length) {
+    int index = universe_find(u, name, length);
+    if (index == -1) {
+        return false;
     }
-    return false;
+    s->nodes[s->size - 1] = index;
+    return true;
 }
 
 /**
- * @brief Parse set from file stream
- * @param fp File pointer
+ * @brief Parse set from line
+ * @param pos Start of line content
+ * @param end End of line
+ * @param s Set
  * @param u Universe
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool parse_set(FILE* fp, struct set* s, struct universe* u) {
-    // Allocate memory for one node
+bool parse_set(const char* pos,
+               const char* end,
+               struct set* s,
+               struct universe* u) {
+    // Allocate memory for initial nodes
     s->nodes = malloc(sizeof(int) * INITIAL_SET_ALLOC);
     // Check malloc
     if (s->nodes == NULL) {
@@ -1862,137 +6421,113 @@ bool parse_set(FILE* fp, struct set* s, struct universe* u) {
     }
 
     s->size = 0;
-    char buffer[STRING_BUFFER_SIZE] = {0};
-    int index = 0;  // Index in buffer
     int a = INITIAL_SET_ALLOC;
 
     while (true) {
-        int c = getc(fp);
-        const bool end = c == EOF || c == '\n';
-
-        if (c == ' ' || end) {
-            s->size++;
-            buffer[index] = '\0';
-            index = 0;
-            // Realloc
-            if (!smart_realloc((void**)&s->nodes, s->size, &a, sizeof(int))) {
-                return alloc_error();
-            }
-            // Find element in universe and set it
-            if (!set_set_node(u, s, buffer)) {
-                return error("Set node is not in universe.\n");
-            }
-            // If character is EOF or newline we can end parsing
-            if (end) {
-                return true;
-            }
-        } else {
-            // Check buffer overflow
-            if (index >= MAX_STRING_LENGTH) {
-                return error("Element name too long!\n");
-            }
-            // Write to buffer
-            buffer[index] = c;
-            index++;
+        const char* token_end = find_char(pos, end, ' ');
+
+        s->size++;
+        // Realloc
+        if (!smart_realloc((void**)&s->nodes, s->size, &a, sizeof(int))) {
+            return alloc_error();
+        }
+        // Find element in universe and set it
+        if (!set_set_node(u, s, pos, token_end - pos)) {
+            return error("Set node is not in universe.\n");
         }
+        // If we are at the end of line we can end parsing
+        if (token_end == end) {
+            return true;
+        }
+        pos = token_end + 1;
     }
-    return true;
 }
 
 /**
- * @brief Parse relation from file stream
- * @param fp File pointer
+ * @brief Parse relation from line
+ * @param pos Start of line content
+ * @param end End of line
  * @param r Relation
  * @param u Universe
  * @retval true - Function executed successfully
  * @retval false - Function failed
  * */
-bool parse_relation(FILE* fp, struct relation* r, struct universe* u) {
+bool parse_relation(const char* pos,
+                    const char* end,
+                    struct relation* r,
+                    struct universe* u) {
+    // Allocate memory for initial nodes
+    r->nodes = malloc(sizeof(struct relation_node) * INITIAL_RELATION_ALLOC);
+    // Check malloc
+    if (r->nodes == NULL) {
+        return alloc_error();
+    }
+
     r->size = 0;
-    char node[STRING_BUFFER_SIZE] = {0};
-    int index = 0;
+    int a = INITIAL_RELATION_ALLOC;
+    const int node_size = sizeof(struct relation_node);
+    const char* token = pos;
     bool read = false, first_loaded = false;
 
-    while (true) {
-        int c = getc(fp);
-
-        // If character is EOF or newline we can end parsing
-        if (c == EOF || c == '\n') {
-            break;
-        }
+    for (; pos < end; pos++) {
+        const char c = *pos;
 
         // If charcater is '(' => we can start reading nodes
         if (c == '(') {
             read = true;
+            token = pos + 1;
             // Memory allocation for node that is to be read
-            r->nodes = srealloc(r->nodes,
-                                sizeof(struct relation_node) * (r->size + 1));
-            continue;
-        }
-
-        // If read is false => skip to load next character
-        if (!read) {
-            continue;
-        }
-
-        // If characeter is ' ' or ')' => node was read, we can save it
-        if (c == ' ' || c == ')') {
-            node[index] = '\0';
-            index = 0;
-
-            // Compares relation node to universe node
-            for (int i = 0; i < u->size; i++) {
-                // Checks if relation node is in universe
-                if (!(strcmp(node, u->nodes[i]))) {
-                    // Checks if we are loading first or second node in relation
-                    if (c != ')') {
-                        r->nodes[r->size].a = i;
-                        first_loaded = true;
-                    } else {
-                        // Checks if first node was loaded
-                        if (!first_loaded) {
-                            return error(
-                                "Relation is missing a second node.\n");
-                        }
-                        r->nodes[r->size++].b = i;
-                        read = false;
-                        first_loaded = false;
-                    }
-                    break;
-                }
-                // If the iteration is the last one => relation node wasn't
-                // found in universe
-                if (i == u->size - 1) {
-                    return error("Relation node is not in universe.\n");
-                }
+            if (!smart_realloc((void**)&r->nodes, r->size + 1, &a,
+                               node_size)) {
+                return alloc_error();
             }
+            continue;
+        }
 
+        // If read is false or we are inside name => skip to next character
+        if (!read || (c != ' ' && c != ')')) {
             continue;
         }
 
-        // Check max element name length
-        if (index >= MAX_STRING_LENGTH) {
-            return error("Element name too long!\n");
+        // Character is ' ' or ')' => node was read, find it in universe
+        int i = universe_find(u, token, pos - token);
+        token = pos + 1;
+        if (i == -1) {
+            return error("Relation node is not in universe.\n");
+        }
+        // Checks if we are loading first or second node in relation
+        if (c != ')') {
+            r->nodes[r->size].a = i;
+            first_loaded = true;
+        } else {
+            // Checks if first node was loaded
+            if (!first_loaded) {
+                return error("Relation is missing a second node.\n");
+            }
+            r->nodes[r->size++].b = i;
+            read = false;
+            first_loaded = false;
         }
-        node[index++] = c;
     }
     return true;
 }
 
 /**
- * @brief Set the command type based on string buffer
+ * @brief Set the command type based on command name
  *
- * @param buffer String buffer
+ * @param name Command name (not terminated)
+ * @param length Command name length
  * @param command Command
  * @return true When command was found
  * @return false Command wasn't found
  */
-bool set_command_type(char* buffer, struct command* command) {
+bool set_command_type(const char* name, int length, struct command* command) {
     // Calculate command defs size
     const int command_count = sizeof(COMMAND_DEFS) / sizeof(COMMAND_DEFS[0]);
     // Loop over all commnad defs
     for (int i = 0; i < command_count; i++) {
-        if (strcmp(COMMAND_DEFS[i].name, buffer) == 0) {
+        if (strncmp(COMMAND_DEFS[i].name, name, length) == 0 &&
+            COMMAND_DEFS[i].name[length] == '\0') {
             command->type = i;
             return true;
         }
@@ -2001,68 +6536,65 @@ bool set_command_type(char* buffer, struct command* command) {
 }
 
 /**
- * @brief Parse command
- * @param fp File pointer
+ * @brief Parse command from line
+ * @param pos Start of line content
+ * @param end End of line
  * @param c Command
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool parse_command(FILE* fp, struct command* command) {
-    char buffer[STRING_BUFFER_SIZE] = {0};
-    int index = 0;
+bool parse_command(const char* pos, const char* end, struct command* command) {
     int argument = 0;
     command->argc = 0;
 
-    // Loop over all chars
+    // Loop over all tokens
     while (true) {
-        const int c = getc(fp);
-        const bool end = c == EOF || c == '\n';
-        // Reset after each space or end
-        if (c == ' ' || end) {
-            buffer[index] = '\0';
-            index = 0;
-            if (argument == 0) {
-                // Find command string in command definitions
-                if (!set_command_type(buffer, command)) {
-                    return error("Command wasn't found!\n");
-                }
-            } else {
-                // Check argument count
-                if (argument > MAX_COMMAND_ARGUMENTS) {
-                    return error("Too many command arguments!\n");
-                }
-                // Parse line number
-                if (!parse_line_number(buffer, &command->args[argument - 1])) {
-                    return error("Invalid line number!\n");
-                }
-                command->argc++;
+        const char* token_end = find_char(pos, end, ' ');
+        const int length = token_end - pos;
+
+        if (argument == 0) {
+            // Check max name size
+            if (length > MAX_STRING_LENGTH) {
+                return error("Command (argument) too long!\n");
             }
-            // End after EOF or \n
-            if (end) {
-                return true;
+            // Find command string in command definitions
+            if (!set_command_type(pos, length, command)) {
+                return error("Command wasn't found!\n");
             }
-            argument++;
         } else {
-            // Check max buffer size
-            if (index >= MAX_STRING_LENGTH) {
-                return error("Command (argument) too long!\n");
+            // Check argument count
+            if (argument > MAX_COMMAND_ARGUMENTS) {
+                return error("Too many command arguments!\n");
+            }
+            // Parse line number
+            if (!parse_line_number(pos, length,
+                                   &command->args[argument - 1])) {
+                return error("Invalid line number!\n");
             }
-            // Write to buffer
-            buffer[index] = c;
-            index++;
+            command->argc++;
         }
+        // End at the end of line
+        if (token_end == end) {
+            return true;
+        }
+        pos = token_end + 1;
+        argument++;
     }
-    return true;
 }
 
 /**
  * @brief Process universe
- * @param fp File pointer
+ * @param pos Start of line content
+ * @param end End of line
  * @param store Store
+ * @param empty Line has no content
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_universe(FILE* fp, struct store* store, bool empty) {
+bool process_universe(const char* pos,
+                      const char* end,
+                      struct store* store,
+                      bool empty) {
     int index = store->size;
 
     store->universe = malloc(sizeof(struct universe));
@@ -2071,210 +6603,511 @@ bool process_universe(FILE* fp, struct store* store, bool empty) {
         return alloc_error();
     }
 
+    store->universe->size = 0;
+    store->universe->names = NULL;
+    store->universe->offsets = NULL;
+    store->universe->table = NULL;
+    store->universe->table_size = 0;
+
     // Empty universe is valid
-    if (empty) {
-        store->universe->nodes = NULL;
-        store->universe->size = 0;
-    } else {
+    if (!empty) {
         // Parse universe
-        if (!parse_universe(fp, store->universe)) {
+        if (!parse_universe(pos, end, store->universe)) {
             return error("Error parsing universe!\n");
         }
 
+        // Build lookup table used by set and relation parsing, this also
+        // checks for repeated words
+        if (!universe_build_table(store->universe)) {
+            return error("Invalid universe!\n");
+        }
+
         // Check if universe is valid
-        if (!universe_valid(store->universe)) {
+        const int command_count =
+            sizeof(COMMAND_DEFS) / sizeof(COMMAND_DEFS[0]);
+        if (!universe_valid(store->universe, COMMAND_DEFS, command_count)) {
             return error("Invalid universe!\n");
         }
     }
 
     // Generate set from universe
     store->nodes[index].type = SET;
+    store->nodes[index].in_arena = false;
+    store->nodes[index].version = 0;
     store->nodes[index].obj = get_set_from_universe(store->universe);
 
     // Check malloc error
     if (store->nodes[index].obj == NULL) {
         return alloc_error();
     }
+    set_pack(store->nodes[index].obj,
+             bitset_words(store->universe->size));
 
     store->size++;
+    if (!store_adopt(store, &store->nodes[index])) {
+        return alloc_error();
+    }
 
     return true;
 }
 
 /**
  * @brief Process set
- * @param fp File pointer
- * @param store Store
+ * @param pos Start of line content
+ * @param end End of line
+ * @param node Store node where set will be stored
+ * @param u Universe
+ * @param empty Line has no content
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_set(FILE* fp, struct store* store, bool empty) {
-    int index = store->size;
-
+bool process_set(const char* pos,
+                 const char* end,
+                 struct store_node* node,
+                 struct universe* u,
+                 bool empty) {
     // Init set object
-    store->nodes[index].type = SET;
-    store->nodes[index].obj = calloc(1, sizeof(struct set));
+    node->type = SET;
+    node->obj = calloc(1, sizeof(struct set));
 
     // Check malloc
-    if (store->nodes[index].obj == NULL) {
+    if (node->obj == NULL) {
         return alloc_error();
     }
 
-    store->size++;
-
     // If set is empty, we can return it, it is completely valid
     if (empty) {
         return true;
     }
 
     // Handle parsing
-    if (!parse_set(fp, store->nodes[index].obj, store->universe)) {
+    if (!parse_set(pos, end, node->obj, u)) {
         return error("Error parsing set!\n");
     }
 
-    // Sort set
-    set_sort(store->nodes[index].obj);
-
-    // Check if set is valid
-    return set_valid(store->nodes[index].obj);
+    // Sort set, this also checks that set is valid
+    if (!set_sort(node->obj)) {
+        return error("Repeated item inside set!\n");
+    }
+    // Store set in layout that takes the least memory
+    set_pack(node->obj, bitset_words(u->size));
+    return true;
 }
 
 /**
  * @brief Process relation
- * @param fp File pointer
- * @param store Store
+ * @param pos Start of line content
+ * @param end End of line
+ * @param node Store node where relation will be stored
+ * @param u Universe
+ * @param empty Line has no content
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_relation(FILE* fp, struct store* store, bool empty) {
-    int index = store->size;
-
+bool process_relation(const char* pos,
+                      const char* end,
+                      struct store_node* node,
+                      struct universe* u,
+                      bool empty) {
     // Init relation object
-    store->nodes[index].type = RELATION;
-    store->nodes[index].obj = calloc(1, sizeof(struct relation));
+    node->type = RELATION;
+    node->obj = calloc(1, sizeof(struct relation));
 
     // Check malloc
-    if (store->nodes[index].obj == NULL) {
+    if (node->obj == NULL) {
         return alloc_error();
     }
 
-    store->size++;
-
     // If relation is empty, we can return it, it is completely valid
     if (empty) {
         return true;
     }
 
     // Parse relation
-    if (!parse_relation(fp, store->nodes[index].obj, store->universe)) {
+    if (!parse_relation(pos, end, node->obj, u)) {
         return error("Error parsing relation!\n");
     }
 
-    // Sort relation
-    relation_sort(store->nodes[index].obj);
-
-    // Check if relation is valid
-    return relation_valid(store->nodes[index].obj);
+    // Sort relation, this also checks that relation is valid
+    // Keys are sorted as numbers, columns are split only after sorting pairs
+    const enum relation_layout layout = relation_fitting_layout(u->size);
+    if (layout == RELATION_PACKED) {
+        relation_convert(node->obj, layout);
+    }
+    if (!relation_sort(node->obj)) {
+        return error("Repeated item inside relation");
+    }
+    relation_convert(node->obj, layout);
+    // Index rows of sorted relation
+    if (!relation_index(node->obj)) {
+        return alloc_error();
+    }
+    return true;
 }
 
 /**
  * @brief Process command
- * @param fp File pointer
- * @param store Store
+ * @param pos Start of line content
+ * @param end End of line
+ * @param node Store node where command will be stored
+ * @param empty Line has no content
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_command(FILE* fp, struct store* store, bool empty) {
+bool process_command(const char* pos,
+                     const char* end,
+                     struct store_node* node,
+                     bool empty) {
     // Command can't be empty
     if (empty) {
         return error("Command can't be empty!\n");
     }
 
-    int index = store->size;
-
     // Init command object
-    store->nodes[index].type = COMMAND;
-    store->nodes[index].obj = malloc(sizeof(struct command));
+    node->type = COMMAND;
+    node->obj = calloc(1, sizeof(struct command));
 
     // Check malloc
-    if (store->nodes[index].obj == NULL) {
+    if (node->obj == NULL) {
         return alloc_error();
     }
 
-    store->size++;
-
     // Parse command
-    if (!parse_command(fp, store->nodes[index].obj)) {
+    if (!parse_command(pos, end, node->obj)) {
         return error("Error parsing command\n");
     }
 
     return true;
 }
 
+/**
+ * @brief Process set, relation or command line into store node
+ * @param line Start of line (with valid line header)
+ * @param end End of line (without newline)
+ * @param node Store node, has to be initialized to command with NULL object
+ * @param u Universe
+ * @retval true - Line was parsed correctly
+ * @retval false - Line wasn't passed correctly
+ */
+bool process_node(const char* line,
+                  const char* end,
+                  struct store_node* node,
+                  struct universe* u) {
+    const bool empty = line + 1 == end;
+    // Skip line type and separating space
+    const char* pos = empty ? end : line + 2;
+
+    switch (line[0]) {
+        case 'S':
+            return process_set(pos, end, node, u, empty);
+        case 'R':
+            return process_relation(pos, end, node, u, empty);
+        case 'C':
+            return process_command(pos, end, node, empty);
+        default:
+            return error("Invalid starting character!\n");
+    }
+}
+
 /**
  * @brief Process one line
- * @param fp File pointer
- * @param c Starting character
+ * @param line Start of line
+ * @param end End of line (without newline)
  * @param store Store
  * @retval true - Line was parsed correctly
  * @retval false - Line wasn't passed correctly
  */
-bool process_line(FILE* fp, char c, struct store* store) {
-    int next = getc(fp);
-    bool empty = next == '\n';
+bool process_line(const char* line, const char* end, struct store* store) {
+    // Empty lines aren't allowed
+    if (line == end) {
+        return false;
+    }
+
+    const char c = line[0];
+    const bool empty = line + 1 == end;
 
     // This shouldn't happen with valid file
     // Ensure that universe will be first and present only once
-    if ((next != ' ' && !empty) ||
+    if ((!empty && line[1] != ' ') ||
         (store->size != 0 && store->universe == NULL) ||
         (c == 'U' && store->size > 0) || (store->size == 0 && c != 'U')) {
         return false;
     }
 
-    switch (c) {
-        case 'U':
-            return process_universe(fp, store, empty);
-        case 'S':
-            return process_set(fp, store, empty);
-        case 'R':
-            return process_relation(fp, store, empty);
-        case 'C':
-            return process_command(fp, store, empty);
-        default:
-            return error("Invalid starting character!\n");
+    if (c == 'U') {
+        return process_universe(empty ? end : line + 2, end, store, empty);
+    }
+
+    // Everything else is stored as next node, init it so it can be freed
+    struct store_node* node = &store->nodes[store->size++];
+    node->type = COMMAND;
+    node->obj = NULL;
+    node->in_arena = false;
+    node->version = 0;
+
+    if (!process_node(line, end, node, store->universe)) {
+        return false;
+    }
+    return store_adopt(store, node) || alloc_error();
+}
+
+/**
+ * @brief Check if line is set or relation with valid line header
+ * @param line Line
+ * @retval true - Line can be parsed independently after universe
+ * @retval false - Line has to be processed in order
+ */
+bool line_is_data(struct line line) {
+    return line.start != line.end &&
+           (line.start[0] == 'S' || line.start[0] == 'R') &&
+           (line.start + 1 == line.end || line.start[1] == ' ');
+}
+
+/**
+ * @brief Worker parsing data lines from shared job
+ * @param arg Parse job
+ * @return Always NULL
+ */
+void* parse_worker(void* arg) {
+    struct parse_job* job = arg;
+    int i;
+    while ((i = work_queue_take(&job->queue)) != -1) {
+        if (!process_node(job->lines[i].start, job->lines[i].end,
+                          &job->store->nodes[i], job->store->universe)) {
+            work_queue_fail(&job->queue);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Process set and relation lines, possibly on multiple threads
+ * @param lines All lines
+ * @param from Index of first line
+ * @param to Index after last line, all lines in range have to be data lines
+ * @param store Store, it must have nodes allocated for all lines
+ * @retval true - All lines were parsed correctly
+ * @retval false - Some line wasn't parsed correctly
+ */
+bool process_data_lines(struct line* lines,
+                        int from,
+                        int to,
+                        struct store* store) {
+    // Init all nodes so they can be freed even when some line fails
+    for (int i = from; i < to; i++) {
+        store->nodes[i].type = COMMAND;
+        store->nodes[i].obj = NULL;
+        store->nodes[i].in_arena = false;
+        store->nodes[i].version = 0;
+    }
+    store->size = to;
+
+    // Small inputs aren't worth starting threads
+    const size_t size = lines[to - 1].end - lines[from].start;
+    const int threads = size < PARALLEL_PARSE_MIN_SIZE ? 1 : store->threads;
+
+    struct parse_job job = {.lines = lines, .store = store};
+    if (!work_queue_init(&job.queue, from, to)) {
+        return alloc_error();
+    }
+    run_parallel(parse_worker, &job, get_min(threads, to - from));
+    work_queue_destroy(&job.queue);
+    if (job.queue.failed) {
+        return false;
+    }
+
+    // Arena isn't shared with workers, nodes are moved into it afterwards
+    for (int i = from; i < to; i++) {
+        if (!store_adopt(store, &store->nodes[i])) {
+            return alloc_error();
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find all lines inside input
+ * @param input Input
+ * @param lines Found lines, array gets allocated
+ * @param count Number of found lines
+ * @retval true - Function executed successfully
+ * @retval false - Allocation failed
+ */
+bool split_lines(struct input* input, struct line** lines, int* count) {
+    int a = INITIAL_STORE_ALLOC;
+    const char* pos = input->data;
+    const char* end = input->data + input->size;
+
+    *count = 0;
+    *lines = malloc(sizeof(struct line) * a);
+    if (*lines == NULL) {
+        return alloc_error();
+    }
+
+    while (pos < end) {
+        const char* line_end = find_char(pos, end, '\n');
+        (*count)++;
+        if (!smart_realloc((void**)lines, *count, &a, sizeof(struct line))) {
+            return alloc_error();
+        }
+        (*lines)[*count - 1].start = pos;
+        (*lines)[*count - 1].end = line_end;
+        pos = line_end + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Parse all lines in input and validate store
+ * @param input Input
+ * @param store Store
+ * @retval true - Function executed successfully
+ * @retval false - Function failed
+ */
+bool parse_file(struct input* input, struct store* store) {
+    struct line* lines;
+    int count;
+    if (!split_lines(input, &lines, &count)) {
+        free(lines);
+        return false;
+    }
+
+    // All lines are known, allocate store at once
+    store->nodes = srealloc(store->nodes,
+                            sizeof(struct store_node) * get_max(count, 1));
+    if (store->nodes == NULL) {
+        free(lines);
+        return alloc_error();
+    }
+
+    // Universe has to be known before anything else can be parsed
+    bool result = count == 0 || process_line(lines[0].start, lines[0].end,
+                                             store);
+    int i = 1;
+    // Sets and relations following universe are independent of each other
+    int data_end = i;
+    while (data_end < count && line_is_data(lines[data_end])) {
+        data_end++;
+    }
+    if (result && data_end > i) {
+        result = process_data_lines(lines, i, data_end, store);
+        i = data_end;
+    }
+    // Remaining lines are processed in order
+    for (; result && i < count; i++) {
+        result = process_line(lines[i].start, lines[i].end, store);
+    }
+    free(lines);
+
+    if (!result) {
+        return error("Error parsing file!\n");
+    }
+    // Check store validity
+    if (!store_valid(store)) {
+        return error("Invalid definition of file parts!\n");
+    }
+
+    return true;
+}
+
+/**
+ * @brief Process all lines in input
+ * @param input Input
+ * @param store Store
+ * @retval true - Function executed successfully
+ * @retval false - Function failed
+ */
+bool process_file(struct input* input, struct store* store) {
+    // Compiled store doesn't need any parsing or validation
+    if (input_is_binary(input)) {
+        if (!load_store(input, store)) {
+            return error("Error loading compiled file!\n");
+        }
+    } else if (!parse_file(input, store)) {
+        return false;
+    }
+    // Run store
+    if (!store_runner(store)) {
+        return error("Error running commands!\n");
     }
+
+    return true;
 }
 
 /**
- * @brief Process all lines in file
+ * @brief Process lines from stream and run them as soon as possible
+ *
+ * Sets and relations no waiting command reads are moved into temporary file
+ * when they take more memory than allowed, they are loaded again when read.
+ * Only store nodes themselves and file offsets grow with line count.
  * @param fp File pointer
  * @param store Store
  * @retval true - Function executed successfully
  * @retval false - Function failed
  */
-bool process_file(FILE* fp, struct store* store) {
+bool process_stream(FILE* fp, struct store* store) {
     int a = INITIAL_STORE_ALLOC;
     const int node_size = sizeof(struct store_node);
+    bool s_or_r_found = false, c_found = false;
+    // Program counter is kept between lines, forward jumps skip lines
+    int pc = 0;
+    char* line = NULL;
+    size_t allocated = 0;
+    ssize_t length;
+    bool result = true;
+    // Results of long streams must not pile up in cache, every line owns its
+    // set or relation instead, so it can be moved into temporary file
+    store->memo.disabled = true;
+    if (!spill_open(&store->spill)) {
+        return false;
+    }
 
-    // Loop around all lines
-    for (int c = 0, i = 2; (c = getc(fp)) != EOF; i++) {
+    // Loop around all lines, only the current line is kept in memory
+    for (int i = 2; (length = getline(&line, &allocated, fp)) != -1; i++) {
+        const char* end = line + length;
+        if (end > line && end[-1] == '\n') {
+            end--;
+        }
         // Realloc store
         if (!smart_realloc((void**)&store->nodes, i, &a, node_size)) {
-            return alloc_error();
+            result = alloc_error();
+            break;
+        }
+        // Parse one line and check it is in correct order
+        if (!process_line(line, end, store) ||
+            (store->size > 1 &&
+             !store_order_valid(store->nodes[store->size - 1].type,
+                                &s_or_r_found, &c_found))) {
+            result = error("Error parsing file!\n");
+            break;
+        }
+        spill_track(&store->spill, &store->nodes[store->size - 1]);
+        // Run everything that can be run with lines read so far
+        if (!store_run(store, &pc, true)) {
+            result = error("Error running commands!\n");
+            break;
         }
-        // Parse one line
-        if (!process_line(fp, c, store)) {
-            return error("Error parsing file!\n");
+        // Don't hold results of this line back until buffer gets full
+        output_flush(&store->output);
+        // Keep only sets and relations waiting commands read
+        if (!spill_cold(store, pc)) {
+            result = false;
+            break;
         }
     }
-    // Check store validity
-    if (!store_valid(store)) {
-        return error("Invalid definition of file parts!\n");
+    free(line);
+
+    if (!result) {
+        return false;
     }
-    // Run store
-    if (!store_runner(store)) {
+    // Run remaining commands, missing lines are now reported as errors
+    if (!store_run(store, &pc, false)) {
         return error("Error running commands!\n");
     }
+    // Check that all parts were present
+    if (!s_or_r_found || !c_found) {
+        return error("Invalid definition of file parts!\n");
+    }
 
     return true;
 }
@@ -2283,51 +7116,165 @@ bool process_file(FILE* fp, struct store* store) {
 /*---------------------------- FILE MANIPULATION ----------------------------*/
 
 /**
- * @brief Open file
- * @param filename File name
- * @retval File pointer if file was opened successfully
- * @retval NULL - Error when opening file
+ * @brief Read whole stream into memory (used when file can't be mapped)
+ * @param fd File descriptor
+ * @param input Input
+ * @retval true - Stream was read
+ * @retval false - Error when reading stream
  */
-FILE* open_file(char* filename) {
-    FILE* fp;
-    fp = fopen(filename, "r");
+bool read_input(int fd, struct input* input) {
+    size_t allocated = INITIAL_INPUT_ALLOC;
+    input->data = malloc(allocated);
+    if (input->data == NULL) {
+        return alloc_error();
+    }
 
-    if (fp == NULL) {
-        error("Failed to open file!\n");
-        return NULL;
+    while (true) {
+        // Grow buffer when it is full
+        if (input->size == allocated) {
+            allocated *= 2;
+            input->data = srealloc(input->data, allocated);
+            if (input->data == NULL) {
+                return alloc_error();
+            }
+        }
+        ssize_t count =
+            read(fd, input->data + input->size, allocated - input->size);
+        if (count < 0) {
+            return error("Failed to read file!\n");
+        }
+        if (count == 0) {
+            return true;
+        }
+        input->size += count;
+    }
+}
+
+/**
+ * @brief Open file and map its content into memory
+ * @param filename File name
+ * @param input Input
+ * @retval true - File was opened successfully
+ * @retval false - Error when opening file
+ */
+bool open_input(char* filename, struct input* input) {
+    input->data = NULL;
+    input->size = 0;
+    input->mapped = false;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        return error("Failed to open file!\n");
+    }
+
+    // Map regular files, fall back to reading for pipes and empty files
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* data =
+            mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            input->data = data;
+            input->size = info.st_size;
+            input->mapped = true;
+        }
     }
 
-    return fp;
+    bool result = input->mapped || read_input(fd, input);
+    close(fd);
+    return result;
 }
 
 /**
- * @brief Close file
- * @param fp File pointer
- * @retval true - file was closed successfully
- * @retval false - Error when closing file
+ * @brief Close input and release its memory
+ * @param input Input
+ * @retval true - Input was closed successfully
+ * @retval false - Error when closing input
  */
-bool close_file(FILE* fp) {
-    if (fclose(fp) == EOF) {
-        return error("Failed to close file!\n");
-    } else {
+bool close_input(struct input* input) {
+    if (!input->mapped) {
+        free(input->data);
         return true;
     }
+    if (munmap(input->data, input->size) != 0) {
+        return error("Failed to close file!\n");
+    }
+    return true;
 }
 #pragma endregion
 #pragma region PROGRAM ARGUMENT FUNCTIONS
 /*------------------------ PROGRAM ARGUMENT FUNCTIONS ------------------------*/
 
 /**
- * @brief Check number of arguments
+ * @brief Parse size argument
+ * @param string Argument
+ * @param result Parsed size
+ * @retval true - Size is valid positive number
+ * @retval false - Size is invalid
+ */
+bool parse_size_argument(char* string, long* result) {
+    char* end_p;
+    *result = strtol(string, &end_p, 10);
+    if (end_p == string || *end_p != '\0' || *result <= 0) {
+        return error("Invalid argument value!\n");
+    }
+    return true;
+}
+
+/**
+ * @brief Parse program arguments
  * @param argc Number of arguments
- * @return True if number of arguments is correct
+ * @param argv Arguments
+ * @param options Parsed options
+ * @return True if arguments are correct
  */
-bool check_arguments(int argc) {
-    if (argc != 2) {
+bool parse_arguments(int argc, char* argv[], struct options* options) {
+    options->input = NULL;
+    options->compile = NULL;
+    options->buffer_size = OUTPUT_BUFFER_SIZE;
+    options->threads = 0;
+    options->stats = false;
+    options->memory = STREAM_MEMORY_LIMIT;
+
+    for (int i = 1; i < argc; i++) {
+        // Flags
+        if (strcmp(argv[i], STATS_ARGUMENT) == 0) {
+            options->stats = true;
+            // Options with value
+        } else if (i + 1 < argc && strcmp(argv[i], COMPILE_ARGUMENT) == 0) {
+            options->compile = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], BUFFER_ARGUMENT) == 0) {
+            long size;
+            if (!parse_size_argument(argv[++i], &size)) {
+                return false;
+            }
+            options->buffer_size = size;
+        } else if (i + 1 < argc && strcmp(argv[i], THREADS_ARGUMENT) == 0) {
+            long threads;
+            if (!parse_size_argument(argv[++i], &threads)) {
+                return false;
+            }
+            options->threads = threads > INT_MAX ? INT_MAX : threads;
+        } else if (i + 1 < argc && strcmp(argv[i], MEMORY_ARGUMENT) == 0) {
+            long memory;
+            if (!parse_size_argument(argv[++i], &memory)) {
+                return false;
+            }
+            options->memory = memory;
+            // Everything else is input, there can be only one
+        } else if (options->input == NULL) {
+            options->input = argv[i];
+        } else {
+            return error("Invalid number of arguments!\n");
+        }
+    }
+
+    // Input is required, standard input can't be compiled
+    if (options->input == NULL ||
+        (options->compile != NULL &&
+         strcmp(options->input, STREAM_ARGUMENT) == 0)) {
         return error("Invalid number of arguments!\n");
-    } else {
-        return true;
     }
+    return true;
 }
 #pragma endregion
 #pragma region ENTRY
@@ -2337,69 +7284,112 @@ bool check_arguments(int argc) {
  * @brief Init store object
  *
  * @param store Store
+ * @param options Program options (output buffer size and thread count)
  * @return true When everything went well
  * @return false When some malloc failed
  */
-bool init_store(struct store* store) {
+bool init_store(struct store* store, struct options* options) {
     // Init store itself
     store->size = 0;
+    store->universe = NULL;
+    store->empty_set = NULL;
+    store->empty_relation = NULL;
+    store->arena.head = NULL;
+    store->memo.entries = NULL;
+    store->memo.size = 0;
+    store->memo.count = 0;
+    store->memo.disabled = false;
+    store->spill.file = NULL;
+    store->spill.offsets = NULL;
+    store->spill.allocated = 0;
+    store->spill.resident = 0;
+    store->spill.limit = options->memory;
+    store->memo.hits = 0;
+    store->memo.misses = 0;
+    // Init output writer
+    if (!output_init(&store->output, stdout, options->buffer_size)) {
+        return alloc_error();
+    }
     store->nodes = malloc(sizeof(struct store_node) * INITIAL_STORE_ALLOC);
     if (store->nodes == NULL) {
+        free_store(store);
         return alloc_error();
     }
-    // Init universe
-    store->universe = NULL;
     // Init empty set object
-    store->empty_set = malloc(sizeof(struct set));
+    store->empty_set = calloc(1, sizeof(struct set));
     if (store->empty_set == NULL) {
         free_store(store);
         return alloc_error();
     }
-    store->empty_set->nodes = NULL;
-    store->empty_set->size = 0;
     // Init empty relation object
-    store->empty_relation = malloc(sizeof(struct relation));
+    store->empty_relation = calloc(1, sizeof(struct relation));
     if (store->empty_relation == NULL) {
         free_store(store);
         return alloc_error();
     }
-    store->empty_relation->nodes = NULL;
-    store->empty_relation->size = 0;
+    // Use all processors unless thread count was set
+    store->threads =
+        options->threads > 0 ? options->threads : get_processor_count();
+    // Scheduling commands only pays off for heavy scripts, so it has to be
+    // asked for explicitly
+    store->schedule = options->threads > 1;
     // Everything went well
     return true;
 }
 
 int main(int argc, char* argv[]) {
-    // Check number of arguments
-    if (!check_arguments(argc)) {
+    // Check arguments
+    struct options options;
+    if (!parse_arguments(argc, argv, &options)) {
         return EXIT_FAILURE;
     }
 
+    // Seed random generator
+    srand(time(NULL));
+
+    // Stream standard input, lines are run as they arrive
+    if (strcmp(options.input, STREAM_ARGUMENT) == 0) {
+        struct store store;
+        if (!init_store(&store, &options)) {
+            return EXIT_FAILURE;
+        }
+        bool result = process_stream(stdin, &store);
+        if (options.stats) {
+            print_memo_stats(&store.memo);
+        }
+        free_store(&store);
+        return result ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Open file
-    FILE* fp = open_file(argv[1]);
-    if (fp == NULL) {
+    struct input input;
+    if (!open_input(options.input, &input)) {
+        close_input(&input);
         return EXIT_FAILURE;
     }
 
-    // Seed random generator
-    srand(time(NULL));
-
     // Initialize store object
     struct store store;
-    if (!init_store(&store)) {
+    if (!init_store(&store, &options)) {
+        close_input(&input);
         return EXIT_FAILURE;
     }
 
-    // Process whole file
-    if (!process_file(fp, &store)) {
+    // Process whole file, or only parse it and write it as binary store
+    if (options.compile != NULL ? !parse_file(&input, &store) ||
+                                      !write_store(&store, options.compile)
+                                : !process_file(&input, &store)) {
         free_store(&store);
-        close_file(fp);
+        close_input(&input);
         return EXIT_FAILURE;
     }
+    if (options.stats) {
+        print_memo_stats(&store.memo);
+    }
     free_store(&store);
 
     // Close file
-    if (!close_file(fp)) {
+    if (!close_input(&input)) {
         return EXIT_FAILURE;
     }
 
@@ -0,0 +1,256 @@
+#!/bin/sh
+status=0
+
+# Names of generated universes, number written in letters
+NAME='function name(i,  s, k) {
+    s = ""
+    for (k = 0; k < 4; k++) {
+        s = sprintf("%c", 97 + i % 26) s
+        i = int(i / 26)
+    }
+    return "x" s
+}'
+
+# Check inputs against their expected outputs, also with threads
+for file in sets.txt rel.txt tests/*.txt; do
+    for threads in 1 4; do
+        ./setcal --threads "$threads" "$file" > test.threads.out 2>&1
+        if ! cmp -s "${file%.txt}.out" test.threads.out; then
+            echo "FAIL: $file with --threads $threads"
+            status=1
+        fi
+    done
+done
+
+# Check that compiled inputs give the same output as text
+for file in sets.txt rel.txt tests/*.txt; do
+    ./setcal --compile test.setb "$file" &&
+        ./setcal test.setb > test.threads.out 2>&1
+    if [ ! -s test.setb ] || ! cmp -s "${file%.txt}.out" test.threads.out
+    then
+        echo "FAIL: $file differs when compiled"
+        status=1
+    fi
+    rm -f test.setb
+done
+
+# Check relation over highest elements of biggest universe stored packed and
+# of smallest universe stored in columns, its elements p, q, y and z are the
+# first and last two ones
+for n in 65536 65537; do
+    awk "$NAME"'
+    BEGIN {
+        n = '"$n"'
+        printf "U"
+        for (i = 0; i < n; i++) printf " %s", name(i)
+        print ""
+        printf "R (%s %s) (%s %s) (%s %s) (%s %s)\n", name(n - 1), name(0),
+            name(0), name(n - 1), name(n - 2), name(n - 1), name(1), name(1)
+        c = split("symmetric antisymmetric transitive function domain " \
+                  "codomain closure_sym closure_trans", commands, " ")
+        for (k = 1; k <= c; k++) printf "C %s 2\n", commands[k]
+    }' > test.big.txt
+    awk "$NAME"'
+    BEGIN {
+        n = '"$n"'
+        p = name(0); q = name(1); y = name(n - 2); z = name(n - 1)
+        print "R (" p " " z ") (" q " " q ") (" y " " z ") (" z " " p ")"
+        print "false"
+        print "false"
+        print "false"
+        print "true"
+        print "S " p " " q " " y " " z
+        print "S " p " " q " " z
+        print "R (" p " " z ") (" q " " q ") (" y " " z ") (" z " " p ") (" \
+            z " " y ")"
+        print "R (" p " " p ") (" p " " z ") (" q " " q ") (" y " " p ") (" \
+            y " " z ") (" z " " p ") (" z " " z ")"
+    }' > test.expected.out
+    for threads in 1 4; do
+        ./setcal --threads "$threads" test.big.txt 2>&1 | tail -n +2 \
+            > test.big.out
+        if ! cmp -s test.expected.out test.big.out; then
+            echo "FAIL: relation over universe of $n elements" \
+                "with --threads $threads"
+            status=1
+        fi
+    done
+done
+
+# Check independent commands over sets big enough to be computed on
+# multiple threads, second level reads results of first one
+awk "$NAME"'
+BEGIN {
+    n = 100000
+    printf "U"
+    for (i = 0; i < n; i++) printf " %s", name(i)
+    print ""
+    for (m = 2; m <= 3; m++) {
+        for (r = 0; r < m; r++) {
+            printf "S"
+            for (i = r; i < n; i += m) printf " %s", name(i)
+            print ""
+        }
+    }
+    print "C union 2 3"
+    print "C intersect 2 4"
+    print "C minus 4 2"
+    print "C complement 6"
+    print "C card 7"
+    print "C intersect 8 9"
+    print "C card 10"
+}' > test.big.txt
+awk "$NAME"'
+BEGIN {
+    n = 100000
+    printf "U"
+    for (i = 0; i < n; i++) printf " %s", name(i)
+    print ""
+    for (m = 2; m <= 3; m++) {
+        for (r = 0; r < m; r++) {
+            printf "S"
+            for (i = r; i < n; i += m) printf " %s", name(i)
+            print ""
+        }
+    }
+    # Union of even and odd, multiples of 6, odd multiples of 3 and
+    # complement of numbers with remainder 2
+    printf "S"
+    for (i = 0; i < n; i++) printf " %s", name(i)
+    printf "\nS"
+    for (i = 0; i < n; i += 6) printf " %s", name(i)
+    printf "\nS"
+    for (i = 3; i < n; i += 6) printf " %s", name(i)
+    printf "\nS"
+    for (i = 0; i < n; i++) if (i % 3 != 2) printf " %s", name(i)
+    print ""
+    print n
+    print "S"
+    print n - int((n + 1) / 3)
+}' > test.expected.out
+for threads in 1 4; do
+    ./setcal --threads "$threads" test.big.txt > test.big.out 2>&1
+    if ! cmp -s test.expected.out test.big.out; then
+        echo "FAIL: independent commands with --threads $threads"
+        status=1
+    fi
+done
+
+# Check that closure of small relation over big universe is quick
+awk "$NAME"'
+BEGIN {
+    n = 200000
+    printf "U"
+    for (i = 0; i < n; i++) printf " %s", name(i)
+    print ""
+    printf "R (%s %s) (%s %s)\n", name(n - 3), name(n - 2), name(n - 2),
+        name(n - 1)
+    print "C closure_trans 2"
+}' > test.big.txt
+if ! timeout 10 ./setcal test.big.txt > test.big.out 2>&1 ||
+    [ "$(tail -n 1 test.big.out)" != "R (xljwf xljwg) (xljwf xljwh) (xljwg xljwh)" ]
+then
+    echo "FAIL: closure_trans over big universe"
+    status=1
+fi
+
+# Check closure of sparse relation searched on multiple threads, relation is
+# made of chains a b c, so closure adds a c to each of them
+awk "$NAME"'
+BEGIN {
+    n = 60000
+    printf "U"
+    for (i = 0; i < n; i++) printf " %s", name(i)
+    print ""
+    printf "R"
+    for (i = 0; i < n; i += 3) {
+        printf " (%s %s) (%s %s)", name(i), name(i + 1), name(i + 1),
+            name(i + 2)
+    }
+    print ""
+    print "C closure_trans 2"
+}' > test.big.txt
+awk "$NAME"'
+BEGIN {
+    printf "R"
+    for (i = 0; i < 60000; i += 3) {
+        printf " (%s %s) (%s %s) (%s %s)", name(i), name(i + 1), name(i),
+            name(i + 2), name(i + 1), name(i + 2)
+    }
+    print ""
+}' > test.expected.out
+for threads in 1 4; do
+    ./setcal --threads "$threads" test.big.txt 2>&1 | tail -n 1 \
+        > test.big.out
+    if ! cmp -s test.expected.out test.big.out; then
+        echo "FAIL: sparse closure_trans with --threads $threads"
+        status=1
+    fi
+done
+
+# Check that streaming from standard input gives same output as file, also
+# when every set and relation gets moved into temporary file, last input
+# jumps back
+printf '%s\n' 'U a b c d' 'S a b' 'S c' 'R (a b) (b c)' 'C union 2 3' \
+    'C minus 2 2' 'C empty 8 10' 'C complement 6' 'C empty 8 5' \
+    'C domain 4' > test.big.txt
+for file in sets.txt rel.txt test.big.txt; do
+    ./setcal "$file" > test.default.out 2>&1
+    default=$?
+    for options in "" "--memory 1" "--memory 1 --threads 4"; do
+        ./setcal $options - < "$file" > test.threads.out 2>&1
+        if [ $? -ne $default ] || ! cmp -s test.default.out test.threads.out
+        then
+            echo "FAIL: $file differs when streamed with options '$options'"
+            status=1
+        fi
+    done
+done
+
+# Check stream longer than line limit of file, commands read sets that were
+# moved into temporary file long ago
+awk "$NAME"'
+BEGIN {
+    srand(3)
+    n = 300
+    printf "U"
+    for (i = 0; i < n; i++) printf " %s", name(i)
+    print ""
+    for (l = 2; l < 1500; l++) {
+        printf "S"
+        for (i = 0; i < n; i++) if (rand() < 0.5) printf " %s", name(i)
+        print ""
+    }
+    for (l = 0; l < 300; l++) {
+        printf "C union %d %d\n", 2 + int(rand() * 1498), 2 + int(rand() * 1498)
+    }
+}' > test.big.txt
+awk '
+/^[US]/ {
+    print
+    line++
+    for (k = 2; k <= NF; k++) member[line, $k] = 1
+    if (line == 1) for (k = 2; k <= NF; k++) names[k - 1] = $k
+    next
+}
+{
+    printf "S"
+    for (k = 1; k in names; k++) {
+        if ((($3, names[k]) in member) || (($4, names[k]) in member)) {
+            printf " %s", names[k]
+        }
+    }
+    print ""
+}' test.big.txt > test.expected.out
+for options in "" "--memory 1" "--memory 65536 --threads 4"; do
+    ./setcal $options - < test.big.txt > test.big.out 2>&1
+    if ! cmp -s test.expected.out test.big.out; then
+        echo "FAIL: long stream with options '$options'"
+        status=1
+    fi
+done
+
+rm -f test.default.out test.threads.out test.big.txt test.big.out \
+    test.expected.out
+[ $status -eq 0 ] && echo "All tests passed"
+exit $status